@@ -1,53 +1,116 @@
 #pragma once
-#include <memory>
-#include <typeinfo>
+#include <new>
+#include <utility>
 #include <exception>
 #include <sstream>
 #include <string>
+#include <functional>
+#include <type_traits>
+#include <cstddef>
 #include "TestException.h"
 #include "TypeName.h"
 
 namespace UnitTest
 {
 
+// AnyHash hashes the argument values std::hash supports (arithmetic, enumeration and
+// pointer types and std::string); any other type hashes to 0, which only means that the
+// setups of a function taking it are told apart by comparing them.
+template <typename T, typename Enable = void>
+class AnyHash
+{
+public:
+	static std::size_t Get(const T& value)
+	{
+		return 0;
+	}
+};
+
+template <typename T>
+class AnyHash<T, typename std::enable_if<std::is_arithmetic<T>::value || std::is_pointer<T>::value>::type>
+{
+public:
+	static std::size_t Get(const T& value)
+	{
+		return std::hash<T>()(value);
+	}
+};
+
+template <typename T>
+class AnyHash<T, typename std::enable_if<std::is_enum<T>::value>::type>
+{
+public:
+	static std::size_t Get(const T& value)
+	{
+		typedef typename std::underlying_type<T>::type Underlying;
+		return std::hash<Underlying>()(static_cast<Underlying>(value));
+	}
+};
+
+template <>
+class AnyHash<std::string>
+{
+public:
+	static std::size_t Get(const std::string& value)
+	{
+		return std::hash<std::string>()(value);
+	}
+};
+
+// Any holds a value of any copyable type for the mock setups and calls.  Values of
+// small types that move without throwing (all arithmetic, enumeration and pointer types)
+// are stored inline, larger ones on the heap.  The type is identified by the address of a
+// per type table of operations, so no RTTI is used; reference types (Set<T&>) and the
+// Any::Match wildcard of a type have tables of their own.
 class Any
 {
 public:
 	Any()
+		: mOperations(nullptr)
 	{
 	}
 
 	Any(const Any& rhs)
-		: mContent(rhs.mContent ? rhs.mContent->Clone() : std::shared_ptr<Placeholder>())
+		: mOperations(nullptr)
 	{
+		if (rhs.mOperations != nullptr)
+			rhs.mOperations->mCopy(rhs, *this);
+		mOperations = rhs.mOperations;
 	}
 
 	Any(Any&& rhs)
-		: mContent(std::move(rhs.mContent))
+		: mOperations(nullptr)
 	{
+		Take(rhs);
 	}
 
 	template <typename T>
 	Any(T value)
-		: mContent(new Holder<T>(value))
+		: mOperations(nullptr)
 	{
+		Holder<T>::Create(*this, std::move(value));
+	}
+
+	~Any()
+	{
+		Reset();
 	}
 
 	template <typename T>
 	static Any MakeMatchAny()
 	{
 		Any any;
-		any.mContent = std::shared_ptr<Placeholder>(new MatchAny<T>());
+		any.mOperations = &MatchAny<T>::mOperations;
 		return any;
 	}
 
 	Any& operator=(const Any& rhs)
 	{
-		if (this != &rhs && mContent != rhs.mContent)
+		if (this != &rhs)
 		{
-			mContent.reset();
-			if (rhs.mContent)
-				mContent = rhs.mContent->Clone();
+			Any copy(rhs);
+			Reset();
+			Take(copy);
 		}
 		return *this;
 	}
@@ -55,21 +118,25 @@ public:
 	Any& operator=(Any&& rhs)
 	{
 		if (this != &rhs)
-			mContent = std::move(rhs.mContent);
+		{
+			Reset();
+			Take(rhs);
+		}
 		return *this;
 	}
 
 	template <typename T>
 	Any& operator=(T value)
 	{
-		mContent = std::shared_ptr<Placeholder>(new Holder<T>(value));
+		Set<T>(std::move(value));
 		return *this;
 	}
 
 	template <typename T>
 	void Set(T value)
 	{
-		mContent = std::shared_ptr<Placeholder>(new Holder<T>(value));
+		Reset();
+		Holder<T>::Create(*this, std::forward<T>(value));
 	}
 
 	enum MatchEnum
@@ -80,168 +147,336 @@ public:
 	template <typename T>
 	T GetValue() const
 	{
-		if (!mContent)
+		if (mOperations == nullptr)
 			throw TestException("Any::GetValue: null pointer reference.");
-		if (mContent->GetType() != typeid(T))
+		if (mOperations->mType != Holder<T>::mOperations.mType)
 			throw TestException("Any::GetValue: type mismatch.");
-		return dynamic_cast<const Holder<T>*>(mContent.get())->mValue;
+		return Holder<T>::Get(*this);
 	}
 
 	bool operator==(const Any& rhs) const
 	{
-		if (!mContent)
+		if (mOperations == nullptr)
 			throw TestException("Any::operator==: null pointer reference (this).");
-		if (!rhs.mContent)
+		if (rhs.mOperations == nullptr)
 			throw TestException("Any::operator==: null pointer reference (rhs).");
-		if (mContent->GetType() != rhs.mContent->GetType())
+		if (mOperations->mType != rhs.mOperations->mType)
 			throw TestException("Any::operator==: type mismatch.");
-		return mContent->IsMatchAny() || rhs.mContent->IsMatchAny() || mContent->IsEqual(rhs.mContent.get());
+		return mOperations->mMatchAny || rhs.mOperations->mMatchAny || mOperations->mIsEqual(*this, rhs);
 	}
 
 	std::string ToString() const
 	{
-		if (!mContent)
+		if (mOperations == nullptr)
 			return "null";
-		return mContent->ToString();
+		return mOperations->mToString(*this);
 	}
 
 	void Throw() const
 	{
-		if (mContent)
-			mContent->Throw();
+		if (mOperations != nullptr)
+			mOperations->mThrow(*this);
 	}
 
 	bool IsNull() const
 	{
-		return !mContent;
+		return mOperations == nullptr;
+	}
+
+	//True for the Any::Match wildcard of a setup, which equals any value of its type.
+	bool IsMatchAny() const
+	{
+		return mOperations != nullptr && mOperations->mMatchAny;
+	}
+
+	//Equal values have equal hashes (see AnyHash); the wildcard has none.
+	std::size_t GetHash() const
+	{
+		return mOperations == nullptr ? 0 : mOperations->mGetHash(*this);
 	}
 
 private:
-	class Placeholder
+	static const std::size_t BufferSize = 4 * sizeof(void*);
+
+	union Storage
+	{
+		void* mPointer;
+		typename std::aligned_storage<BufferSize>::type mBuffer;
+	};
+
+	//The type of an Any: how to copy, move, destroy, compare, hash, print and throw its value.
+	class Operations
 	{
 	public:
-		virtual ~Placeholder()
-		{
-		}
+		const void* mType;
+		bool mMatchAny;
+		void (*mCopy)(const Any& from, Any& to);
+		void (*mMove)(Any& from, Any& to);
+		void (*mDestroy)(Any& any);
+		bool (*mIsEqual)(const Any& lhs, const Any& rhs);
+		std::size_t (*mGetHash)(const Any& any);
+		std::string (*mToString)(const Any& any);
+		void (*mThrow)(const Any& any);
+	};
 
-		virtual std::shared_ptr<Placeholder> Clone() const = 0;
-		virtual const std::type_info& GetType() const = 0;
-		virtual void Throw() const = 0;
-		virtual bool IsEqual(const Placeholder* rhs) const = 0;
-		virtual bool IsMatchAny() const = 0;
-		virtual std::string ToString() const = 0;
+	//Its address identifies the type T.
+	template <typename T>
+	class TypeId
+	{
+	public:
+		static const char mId;
 	};
 
 	template <typename T>
-	class Holder : public Placeholder
+	class Holder
 	{
 	public:
-		Holder(T value)
-			: mValue(value)
+		typedef typename std::remove_cv<T>::type Value;
+
+		static const bool IsInline = sizeof(Value) <= BufferSize
+			&& alignof(Value) <= alignof(Storage)
+			&& std::is_nothrow_move_constructible<Value>::value;
+
+		template <typename TValue>
+		static void Create(Any& any, TValue&& value)
 		{
+			Construct(any, std::forward<TValue>(value), std::integral_constant<bool, IsInline>());
+			any.mOperations = &mOperations;
 		}
-		virtual std::shared_ptr<Placeholder> Clone() const
+
+		static const Value& Get(const Any& any)
 		{
-			return std::shared_ptr<Placeholder>(new Holder<T>(mValue));
+			return IsInline
+				? *reinterpret_cast<const Value*>(&any.mStorage.mBuffer)
+				: *static_cast<const Value*>(any.mStorage.mPointer);
 		}
-		virtual const std::type_info& GetType() const
+
+		static const Operations mOperations;
+
+	private:
+		template <typename TValue>
+		static void Construct(Any& any, TValue&& value, std::true_type)
 		{
-			return typeid(T);
+			new (&any.mStorage.mBuffer) Value(std::forward<TValue>(value));
 		}
-		virtual void Throw() const
+
+		template <typename TValue>
+		static void Construct(Any& any, TValue&& value, std::false_type)
 		{
-			throw mValue;
+			any.mStorage.mPointer = new Value(std::forward<TValue>(value));
 		}
-		virtual bool IsEqual(const Placeholder* rhs) const
+
+		static Value& Get(Any& any)
 		{
-			return mValue == dynamic_cast<const Holder<T>*>(rhs)->mValue;
+			return const_cast<Value&>(Get(static_cast<const Any&>(any)));
 		}
-		virtual bool IsMatchAny() const
+
+		static void Copy(const Any& from, Any& to)
 		{
-			return false;
+			Construct(to, Get(from), std::integral_constant<bool, IsInline>());
 		}
-		virtual std::string ToString() const
+
+		static void Move(Any& from, Any& to)
+		{
+			if (IsInline)
+			{
+				Construct(to, std::move(Get(from)), std::integral_constant<bool, IsInline>());
+				Destroy(from);
+			}
+			else
+				to.mStorage.mPointer = from.mStorage.mPointer;
+		}
+
+		static void Destroy(Any& any)
+		{
+			if (IsInline)
+				Get(any).~Value();
+			else
+				delete &Get(any);
+		}
+
+		static bool IsEqual(const Any& lhs, const Any& rhs)
+		{
+			return Get(lhs) == Get(rhs);
+		}
+
+		static std::size_t GetHash(const Any& any)
+		{
+			return AnyHash<Value>::Get(Get(any));
+		}
+
+		static std::string ToString(const Any& any)
 		{
 			std::ostringstream out;
-			out << TypeName<T>::Get() << "='" << mValue << "'";
+			out << TypeName<Value>::Get() << "='" << Get(any) << "'";
 			return out.str();
 		}
 
-		T mValue;
+		static void Throw(const Any& any)
+		{
+			throw Get(any);
+		}
 	};
 
 	template <typename T>
-	class Holder<T&> : public Placeholder
+	class Holder<T&>
 	{
 	public:
-		Holder(T& value)
-			: mValue(value)
+		static void Create(Any& any, T& value)
 		{
+			any.mStorage.mPointer = const_cast<void*>(static_cast<const void*>(&value));
+			any.mOperations = &mOperations;
 		}
-		virtual std::shared_ptr<Placeholder> Clone() const
+
+		static T& Get(const Any& any)
 		{
-			return std::shared_ptr<Placeholder>(new Holder<T&>(mValue));
+			return *static_cast<T*>(any.mStorage.mPointer);
 		}
-		virtual const std::type_info& GetType() const
+
+		static const Operations mOperations;
+
+	private:
+		static void Copy(const Any& from, Any& to)
 		{
-			return typeid(T&);
+			to.mStorage.mPointer = from.mStorage.mPointer;
 		}
-		virtual void Throw() const
+
+		static void Move(Any& from, Any& to)
 		{
-			std::ostringstream out;
-			out << "Cannot re-throw " << TypeName<T>::Get() << "& type.";
-			throw TestException(out.str());
+			to.mStorage.mPointer = from.mStorage.mPointer;
 		}
-		virtual bool IsEqual(const Placeholder* rhs) const
+
+		static void Destroy(Any& any)
 		{
-			return &mValue == &dynamic_cast<const Holder<T&>*>(rhs)->mValue;
 		}
-		virtual bool IsMatchAny() const
+
+		static bool IsEqual(const Any& lhs, const Any& rhs)
 		{
-			return false;
+			return lhs.mStorage.mPointer == rhs.mStorage.mPointer;
 		}
-		virtual std::string ToString() const
+
+		static std::size_t GetHash(const Any& any)
+		{
+			return std::hash<void*>()(any.mStorage.mPointer);
+		}
+
+		static std::string ToString(const Any& any)
 		{
 			std::ostringstream out;
-			out << TypeName<T>::Get() << "&='" << mValue << "'";
+			out << TypeName<T>::Get() << "&='" << Get(any) << "'";
 			return out.str();
 		}
 
-		T& mValue;
+		static void Throw(const Any& any)
+		{
+			std::ostringstream out;
+			out << "Cannot re-throw " << TypeName<T>::Get() << "& type.";
+			throw TestException(out.str());
+		}
 	};
 
 	template <typename T>
-	class MatchAny : public Placeholder
+	class MatchAny
 	{
 	public:
-		virtual std::shared_ptr<Placeholder> Clone() const
+		static const Operations mOperations;
+
+	private:
+		static void Copy(const Any& from, Any& to)
 		{
-			return std::shared_ptr<Placeholder>(new MatchAny<T>());
 		}
-		virtual const std::type_info& GetType() const
+
+		static void Move(Any& from, Any& to)
 		{
-			return typeid(T);
 		}
-		virtual void Throw() const
+
+		static void Destroy(Any& any)
 		{
 		}
-		virtual bool IsEqual(const Placeholder* rhs) const
+
+		static bool IsEqual(const Any& lhs, const Any& rhs)
 		{
 			return false;
 		}
-		virtual bool IsMatchAny() const
+
+		static std::size_t GetHash(const Any& any)
 		{
-			return true;
+			return 0;
 		}
-		virtual std::string ToString() const
+
+		static std::string ToString(const Any& any)
 		{
 			return "any";
 		}
+
+		static void Throw(const Any& any)
+		{
+		}
 	};
 
-	std::shared_ptr<Placeholder> mContent;
+	void Reset()
+	{
+		if (mOperations != nullptr)
+		{
+			mOperations->mDestroy(*this);
+			mOperations = nullptr;
+		}
+	}
+
+	//Moves the value of rhs, leaving rhs empty.
+	void Take(Any& rhs)
+	{
+		if (rhs.mOperations == nullptr)
+			return;
+		rhs.mOperations->mMove(rhs, *this);
+		mOperations = rhs.mOperations;
+		rhs.mOperations = nullptr;
+	}
+
+	const Operations* mOperations;
+	Storage mStorage;
 };
 
+template <typename T>
+const char Any::TypeId<T>::mId = 0;
+
+template <typename T>
+const Any::Operations Any::Holder<T>::mOperations = {
+	&TypeId<typename std::remove_cv<T>::type>::mId,
+	false,
+	&Holder<T>::Copy,
+	&Holder<T>::Move,
+	&Holder<T>::Destroy,
+	&Holder<T>::IsEqual,
+	&Holder<T>::GetHash,
+	&Holder<T>::ToString,
+	&Holder<T>::Throw };
+
+template <typename T>
+const Any::Operations Any::Holder<T&>::mOperations = {
+	&TypeId<T&>::mId,
+	false,
+	&Holder<T&>::Copy,
+	&Holder<T&>::Move,
+	&Holder<T&>::Destroy,
+	&Holder<T&>::IsEqual,
+	&Holder<T&>::GetHash,
+	&Holder<T&>::ToString,
+	&Holder<T&>::Throw };
+
+//Arguments are held by value, so the wildcard of a const T& argument has the type of T.
+template <typename T>
+const Any::Operations Any::MatchAny<T>::mOperations = {
+	&TypeId<typename std::decay<T>::type>::mId,
+	true,
+	&MatchAny<T>::Copy,
+	&MatchAny<T>::Move,
+	&MatchAny<T>::Destroy,
+	&MatchAny<T>::IsEqual,
+	&MatchAny<T>::GetHash,
+	&MatchAny<T>::ToString,
+	&MatchAny<T>::Throw };
+
 template <typename TOutput, typename TInput>
 inline Any any_cast(TInput value)
 {
@@ -255,4 +490,3 @@ inline Any any_cast(Any::MatchEnum value)
 }
 
 }
-
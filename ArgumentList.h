@@ -36,14 +36,16 @@ class BuildArgumentList
 {
 };
 
+//Stores the arguments of a call in consecutive Any values, e.g. a std::array of the
+//size of the argument list, without allocating for small arguments.
 template <typename TArg, typename... TArgs>
 class BuildArgumentList<TArg, TArgs...>
 {
 public:
-	static void Build(ArgumentList& arguments, TArg arg, TArgs... args)
+	static void Build(Any* arguments, TArg arg, TArgs... args)
 	{
-		arguments(arg);
-		BuildArgumentList<TArgs...>::Build(arguments, args...);
+		*arguments = Any(arg);
+		BuildArgumentList<TArgs...>::Build(arguments + 1, args...);
 	}
 };
 
@@ -51,7 +53,7 @@ template <>
 class BuildArgumentList<>
 {
 public:
-	static void Build(ArgumentList& arguments)
+	static void Build(Any* arguments)
 	{
 	}
 };
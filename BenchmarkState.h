@@ -0,0 +1,137 @@
+#pragma once
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace UnitTest
+{
+
+// BenchmarkState drives the loop of a BENCHMARK_METHOD.  The benchmark runs its measured
+// code while KeepRunning returns true; only the time between the first and the last call
+// of KeepRunning is measured, so setup before the loop (and BeginTest/EndTest) is not.
+//
+// Example:
+//	BENCHMARK_METHOD(Parse)
+//	{
+//		std::string text = "12345";
+//		while (state.KeepRunning())
+//			UnitTest::DoNotOptimize(std::stoi(text));
+//	}
+class BenchmarkState
+{
+public:
+	explicit BenchmarkState(unsigned long long iterations)
+		: mIterations(iterations), mRemaining(iterations), mStarted(false), mElapsedNanoseconds(0)
+	{
+	}
+
+	bool KeepRunning()
+	{
+		if (mRemaining != 0)
+		{
+			if (!mStarted)
+			{
+				mStarted = true;
+				mStart = std::chrono::steady_clock::now();
+			}
+			--mRemaining;
+			return true;
+		}
+		if (mStarted)
+		{
+			mElapsedNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+			mStarted = false;
+		}
+		return false;
+	}
+
+	unsigned long long GetIterations() const
+	{
+		return mIterations;
+	}
+
+	//True once KeepRunning returned false.
+	bool IsComplete() const
+	{
+		return mRemaining == 0 && !mStarted;
+	}
+
+	unsigned long long GetElapsedNanoseconds() const
+	{
+		return mElapsedNanoseconds;
+	}
+
+	//Returns the state installed on this thread by a Scope, else a new single iteration
+	//state (so a benchmark run as a unit test, e.g. by RunSingleTest, runs once).
+	static BenchmarkState& GetCurrent()
+	{
+		static thread_local BenchmarkState single(1);
+		if (Current() != nullptr)
+			return *Current();
+		single = BenchmarkState(1);
+		return single;
+	}
+
+	// Scope installs a state as the current state of the calling thread.
+	class Scope
+	{
+	public:
+		Scope(BenchmarkState& state)
+			: mPrevious(Current())
+		{
+			Current() = &state;
+		}
+		~Scope()
+		{
+			Current() = mPrevious;
+		}
+
+		Scope(const Scope& rhs) = delete;
+		Scope& operator=(const Scope& rhs) = delete;
+
+	private:
+		BenchmarkState* mPrevious;
+	};
+
+private:
+	static BenchmarkState*& Current()
+	{
+		static thread_local BenchmarkState* current = nullptr;
+		return current;
+	}
+
+private:
+	unsigned long long mIterations;
+	unsigned long long mRemaining;
+	bool mStarted;
+	std::chrono::steady_clock::time_point mStart;
+	unsigned long long mElapsedNanoseconds;
+};
+
+//Makes the compiler assume that value is read (and may be modified through memory), so
+//that the computation producing it is not optimized away.
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+	static const void* volatile sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+//Makes the compiler assume that all memory is read and written, so that pending stores
+//are not optimized away.
+inline void ClobberMemory()
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : : "memory");
+#endif
+}
+
+}
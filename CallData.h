@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <atomic>
 #include "Any.h"
 #include "ReturnValue.h"
 
@@ -16,9 +17,42 @@ public:
 	{
 	}
 
-	CallData(const CallData& rhs) = default;
-	CallData(CallData&& rhs) = default;
-	CallData& operator=(const CallData& rhs) = default;
+	CallData(const CallData& rhs)
+		: mOffset(rhs.mOffset),
+		mArguments(rhs.mArguments),
+		mExpectedCalls(rhs.mExpectedCalls),
+		mActualCalls(rhs.mActualCalls.load()),
+		mThrowValue(rhs.mThrowValue),
+		mReturnValue(rhs.mReturnValue),
+		mCallback(rhs.mCallback)
+	{
+	}
+
+	CallData(CallData&& rhs)
+		: mOffset(rhs.mOffset),
+		mArguments(std::move(rhs.mArguments)),
+		mExpectedCalls(rhs.mExpectedCalls),
+		mActualCalls(rhs.mActualCalls.load()),
+		mThrowValue(std::move(rhs.mThrowValue)),
+		mReturnValue(std::move(rhs.mReturnValue)),
+		mCallback(std::move(rhs.mCallback))
+	{
+	}
+
+	CallData& operator=(const CallData& rhs)
+	{
+		if (this != &rhs)
+		{
+			mOffset = rhs.mOffset;
+			mArguments = rhs.mArguments;
+			mExpectedCalls = rhs.mExpectedCalls;
+			mActualCalls = rhs.mActualCalls.load();
+			mThrowValue = rhs.mThrowValue;
+			mReturnValue = rhs.mReturnValue;
+			mCallback = rhs.mCallback;
+		}
+		return *this;
+	}
 
 	CallData& operator=(CallData&& rhs)
 	{
@@ -27,7 +61,7 @@ public:
 			mOffset = std::move(rhs.mOffset);
 			mArguments = std::move(rhs.mArguments);
 			mExpectedCalls = std::move(rhs.mExpectedCalls);
-			mActualCalls = std::move(rhs.mActualCalls);
+			mActualCalls = rhs.mActualCalls.load();
 			mThrowValue = std::move(rhs.mThrowValue);
 			mReturnValue = std::move(rhs.mReturnValue);
 			mCallback = std::move(rhs.mCallback);
@@ -94,7 +128,8 @@ public:
 	unsigned long mOffset;
 	std::vector<Any> mArguments;
 	unsigned long mExpectedCalls;
-	unsigned long mActualCalls;
+	//Counted by Mock<T>::Invoke, which may be called on several threads at once.
+	std::atomic<unsigned long> mActualCalls;
 	Any mThrowValue;
 	Any mReturnValue;
 	CallbackPtr mCallback;
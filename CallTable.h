@@ -0,0 +1,138 @@
+#pragma once
+#include <list>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include "Any.h"
+#include "CallData.h"
+
+namespace UnitTest
+{
+
+// CallTable holds the setups of one mocked virtual function in the order they were made.
+// A call matches the first setup whose arguments equal the actual arguments.  Setups
+// without an Any::Match argument are indexed by the hash of their arguments, so finding
+// the setup of a call only compares the setups in its hash bucket and the setups with
+// wildcards, which are scanned in order.
+class CallTable
+{
+public:
+	CallTable(const std::string& signature)
+		: mSignature(signature), mNextSequence(0)
+	{
+	}
+
+	CallTable(const CallTable& rhs) = delete;
+	CallTable& operator=(const CallTable& rhs) = delete;
+
+	const std::string& GetSignature() const
+	{
+		return mSignature;
+	}
+
+	const std::list<CallData>& GetCalls() const
+	{
+		return mCalls;
+	}
+
+	//Returns the added setup, which stays at the same address until Clear.
+	CallData& Add(const CallData& callData)
+	{
+		mCalls.push_back(callData);
+		auto& added = mCalls.back();
+		Entry entry(mNextSequence++, added);
+		if (HasMatchAny(added.mArguments))
+			mWildcards.push_back(entry);
+		else
+			mExact[GetHash(added.mArguments.data(), added.mArguments.size())].push_back(entry);
+		return added;
+	}
+
+	void Clear()
+	{
+		mCalls.clear();
+		mExact.clear();
+		mWildcards.clear();
+		mNextSequence = 0;
+	}
+
+	//Returns the first setup matching the count arguments or nullptr.  Only reads the
+	//table, so calls may be made on several threads while no setup is added.
+	CallData* Find(const Any* arguments, std::size_t count) const
+	{
+		const Entry* found = nullptr;
+		auto bucket = mExact.find(GetHash(arguments, count));
+		if (bucket != mExact.end())
+		{
+			for (auto& entry : bucket->second)
+			{
+				if (IsMatch(entry.mCallData->mArguments, arguments, count))
+				{
+					found = &entry;
+					break;
+				}
+			}
+		}
+		//Only a wildcard setup made before the exact one can take precedence.
+		for (auto& entry : mWildcards)
+		{
+			if (found != nullptr && entry.mSequence > found->mSequence)
+				break;
+			if (IsMatch(entry.mCallData->mArguments, arguments, count))
+			{
+				found = &entry;
+				break;
+			}
+		}
+		return found == nullptr ? nullptr : found->mCallData;
+	}
+
+private:
+	class Entry
+	{
+	public:
+		Entry(unsigned long sequence, CallData& callData)
+			: mSequence(sequence), mCallData(&callData)
+		{
+		}
+
+		unsigned long mSequence;
+		CallData* mCallData;
+	};
+
+	static bool HasMatchAny(const std::vector<Any>& arguments)
+	{
+		for (auto& argument : arguments)
+			if (argument.IsMatchAny())
+				return true;
+		return false;
+	}
+
+	static bool IsMatch(const std::vector<Any>& expected, const Any* arguments, std::size_t count)
+	{
+		if (expected.size() != count)
+			return false;
+		for (std::size_t index = 0; index < count; ++index)
+			if (!(expected[index] == arguments[index]))
+				return false;
+		return true;
+	}
+
+	static std::size_t GetHash(const Any* arguments, std::size_t count)
+	{
+		std::size_t hash = count;
+		for (std::size_t index = 0; index < count; ++index)
+			hash ^= arguments[index].GetHash() + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+private:
+	std::string mSignature;
+	std::list<CallData> mCalls;
+	std::unordered_map<std::size_t, std::vector<Entry>> mExact;
+	std::vector<Entry> mWildcards;
+	unsigned long mNextSequence;
+};
+
+}
@@ -7,6 +7,8 @@ class ITestClass
 {
 public:
 	virtual const char* GetTestClassName() const = 0;
+	//Restores a reused instance (see TestClass::ReuseInstance) before BeginTest.
+	virtual void Reset() = 0;
 	virtual void BeginTest() = 0;
 	virtual void EndTest() = 0;
 };
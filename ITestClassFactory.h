@@ -1,5 +1,6 @@
 #pragma once
 #include <memory>
+#include <cstddef>
 #include "ITestClass.h"
 #include "ITestMethodFactory.h"
 
@@ -12,7 +13,17 @@ public:
 	virtual const char* GetTestClassName() const = 0;
 	virtual void InitializeTests() = 0;
 	virtual std::shared_ptr<ITestClass> CreateInstance() const = 0;
+	//Constructs the test class in storage of at least GetInstanceSize bytes aligned to
+	//GetInstanceAlignment, without allocating; DestroyInstance destroys it again.
+	virtual std::size_t GetInstanceSize() const = 0;
+	virtual std::size_t GetInstanceAlignment() const = 0;
+	virtual ITestClass* ConstructInstance(void* storage) const = 0;
+	virtual void DestroyInstance(ITestClass* instance) const = 0;
+	//True if the unit tests of the class running on one thread share an instance.
+	virtual bool IsInstanceReused() const = 0;
 	virtual void TerminateTests() = 0;
+	//Timeout in milliseconds for each unit test of the class (0 uses the run's default).
+	virtual unsigned long GetTestClassTimeout() const = 0;
 	virtual unsigned long GetCount() const = 0;
 	virtual ITestMethodFactory& Get(unsigned long index) const = 0;
 };
@@ -11,7 +11,13 @@ class ITestMethodFactory
 public:
 	virtual const char* GetTestMethodName() const = 0;
 	virtual const char* GetTestMethodLocation() const = 0;
+	//Timeout in milliseconds for the unit test (0 uses the test class timeout).
+	virtual unsigned long GetTestMethodTimeout() const = 0;
+	//True for a BENCHMARK_METHOD, which only runs with RunBenchmarks.
+	virtual bool IsBenchmark() const = 0;
 	virtual std::shared_ptr<ITestMethod> CreateInstance(ITestClass* object) const = 0;
+	//Runs the test method on an instance of its test class without creating an ITestMethod.
+	virtual void Execute(ITestClass& object) const = 0;
 };
 
 }
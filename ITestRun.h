@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "TestTiming.h"
 
 namespace UnitTest
 {
@@ -11,7 +12,17 @@ public:
 	virtual void OnBeginClass(const char* className, unsigned long methodCount) = 0;
 	virtual void OnBeginMethod(const char* methodName) = 0;
 	virtual void OnEndMethod(bool passed, const std::string& description) = 0;
+	//Extended OnEndMethod that also receives the timing of the unit test.  The test runner
+	//always calls this overload; the default implementation forwards to the one above.
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		OnEndMethod(passed, description);
+	}
 	virtual void OnEndClass() = 0;
+	//Informational message or warning about the run (e.g. slow test regressions).
+	virtual void OnMessage(const std::string& message)
+	{
+	}
 	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount) = 0;
 };
 
@@ -3,6 +3,7 @@
 #include <memory>
 #include "InjectRegister.h"
 #include "Inject.h"
+#include "TestAllocations.h"
 
 namespace UnitTest
 {
@@ -36,9 +37,17 @@ public:
 
 	static std::shared_ptr<T> Resolve()
 	{
-		static std::shared_ptr<T> instance(new TInject(Inject<TArgs>::Resolve()...));
+		static std::shared_ptr<T> instance(Create());
 		return instance;
 	}
+
+private:
+	static std::shared_ptr<T> Create()
+	{
+		//The singleton outlives the unit test that first resolves it, so it is not that test's leak.
+		TestAllocationPause pause;
+		return std::shared_ptr<T>(new TInject(Inject<TArgs>::Resolve()...));
+	}
 };
 
 //Template static member initialization
@@ -0,0 +1,501 @@
+#pragma once
+#if !defined(_WIN32)
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "ITestRun.h"
+#include "TestPlan.h"
+#include "TestResult.h"
+#include "RunOptions.h"
+#include "TestMethodRunner.h"
+#include "TestStackTrace.h"
+
+namespace UnitTest
+{
+
+// IsolatedTestRunner runs the test methods of one test class in forked worker
+// processes.  The workers are forked after the parent has called InitializeTests
+// so that static fixture state is shared copy-on-write instead of being rebuilt
+// per test.  Each worker reads method positions from a command pipe, runs them and
+// writes the TestResult back over a result pipe.  A worker that dies (crash, signal,
+// exit) fails the test it was running and is replaced by a fresh fork.
+//
+// A worker that exceeds the timeout of its test method is asked for its stack with
+// TestStackTrace's signal, then killed; the stack is symbolized in the parent.
+//
+// Once maxFailures test methods have failed (0 for no limit) no further test method
+// is dispatched; the test methods that were not run are not reported.
+class IsolatedTestRunner
+{
+public:
+	static void RunTestMethods(
+		ITestRun& testRun,
+		const TestPlanClass& entry,
+		unsigned long workerCount,
+		const RunOptions& options,
+		unsigned long maxFailures,
+		unsigned long& passedCount,
+		unsigned long& failedCount)
+	{
+		IsolatedTestRunner runner(entry, options, maxFailures);
+		runner.Run(testRun, workerCount == 0 ? 1 : workerCount, passedCount, failedCount);
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	class Worker
+	{
+	public:
+		Worker()
+			: mProcess(-1), mCommand(-1), mResult(-1), mPosition(0), mBusy(false), mTimeout(0)
+		{
+		}
+
+		pid_t mProcess;
+		int mCommand;
+		int mResult;
+		std::uint32_t mPosition;
+		bool mBusy;
+		unsigned long mTimeout;
+		Clock::time_point mDeadline;
+	};
+
+	IsolatedTestRunner(const TestPlanClass& entry, const RunOptions& options, unsigned long maxFailures)
+		: mEntry(entry),
+		mDefaultTimeout(options.mTimeoutMilliseconds),
+		mMaxFailures(maxFailures),
+		mAllocations(options.mAllocations),
+		mHardwareCounters(options.mHardwareCounters),
+		mRepeatCount(options.mRepeatCount),
+		mStressThreads(options.mStressThreads),
+		mFailures(0),
+		mResults(entry.mMethods.size()),
+		mCompleted(entry.mMethods.size(), false),
+		mSkipped(entry.mMethods.size(), false),
+		mNextReport(0)
+	{
+		for (auto position = 0ul; position < entry.mMethods.size(); ++position)
+			mPending.push_back(position);
+	}
+
+	void Run(ITestRun& testRun, unsigned long workerCount, unsigned long& passedCount, unsigned long& failedCount)
+	{
+		auto previousHandler = ::signal(SIGPIPE, SIG_IGN);
+		mWorkers.resize(std::min<unsigned long>(workerCount, mPending.size()));
+		for (auto& worker : mWorkers)
+			Dispatch(worker);
+
+		while (!AllCompleted())
+		{
+			std::vector<pollfd> descriptors;
+			for (auto& worker : mWorkers)
+			{
+				pollfd descriptor = { worker.mBusy ? worker.mResult : -1, POLLIN, 0 };
+				descriptors.push_back(descriptor);
+			}
+			if (::poll(descriptors.data(), descriptors.size(), GetPollTimeout()) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				FailPending("poll failed while waiting for test processes.");
+				break;
+			}
+
+			auto now = Clock::now();
+			for (auto index = 0ul; index < mWorkers.size(); ++index)
+				if (mWorkers[index].mBusy && descriptors[index].revents != 0)
+					Receive(mWorkers[index]);
+				else if (mWorkers[index].mBusy && mWorkers[index].mTimeout != 0 && now >= mWorkers[index].mDeadline)
+					Expire(mWorkers[index]);
+
+			ReportCompleted(testRun, passedCount, failedCount);
+		}
+
+		for (auto& worker : mWorkers)
+			Stop(worker);
+		ReportCompleted(testRun, passedCount, failedCount);
+		::signal(SIGPIPE, previousHandler);
+	}
+
+	bool AllCompleted() const
+	{
+		return mNextReport == mResults.size();
+	}
+
+	//Returns the milliseconds until the earliest deadline of a busy worker or -1 if there is none.
+	int GetPollTimeout() const
+	{
+		auto timeout = -1;
+		auto now = Clock::now();
+		for (auto& worker : mWorkers)
+			if (worker.mBusy && worker.mTimeout != 0)
+			{
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(worker.mDeadline - now).count() + 1;
+				if (remaining < 0)
+					remaining = 0;
+				if (timeout < 0 || remaining < timeout)
+					timeout = static_cast<int>(remaining);
+			}
+		return timeout;
+	}
+
+	void Dispatch(Worker& worker)
+	{
+		if (mMaxFailures != 0 && mFailures >= mMaxFailures)
+			SkipPending();
+		while (!mPending.empty())
+		{
+			if (worker.mProcess < 0 && !Start(worker))
+			{
+				FailPending("Unable to fork test process.");
+				return;
+			}
+
+			worker.mPosition = mPending.front();
+			if (WriteAll(worker.mCommand, &worker.mPosition, sizeof(worker.mPosition)))
+			{
+				mPending.pop_front();
+				worker.mBusy = true;
+				worker.mTimeout = TestMethodRunner::GetTimeout(*mEntry.mFactory, mEntry.mMethods[worker.mPosition], mDefaultTimeout);
+				worker.mDeadline = Clock::now() + std::chrono::milliseconds(worker.mTimeout);
+				return;
+			}
+			Stop(worker);
+		}
+	}
+
+	void Receive(Worker& worker)
+	{
+		std::uint32_t position = 0;
+		TestResult result;
+		if (ReadAll(worker.mResult, &position, sizeof(position)) && ReadResult(worker.mResult, position, result))
+			Complete(worker.mPosition, result);
+		else
+		{
+			auto status = Stop(worker);
+			Complete(worker.mPosition, Crashed(worker.mPosition, status));
+		}
+		worker.mBusy = false;
+		Dispatch(worker);
+	}
+
+	//Fails the worker's test method with the worker's stack (if it responds in time) and replaces the worker.
+	void Expire(Worker& worker)
+	{
+		std::string stack;
+		auto signal = TestStackTrace::GetSignal();
+		pollfd descriptor = { worker.mResult, POLLIN, 0 };
+		if (signal != 0 && ::kill(worker.mProcess, signal) == 0 && ::poll(&descriptor, 1, 1000) > 0)
+		{
+			std::uint32_t position = 0;
+			TestResult result;
+			if (ReadAll(worker.mResult, &position, sizeof(position)))
+			{
+				if (position == TestStackTrace::FrameMarker)
+					stack = ReadStack(worker.mResult);
+				else if (ReadResult(worker.mResult, position, result))
+				{
+					//Finished just in time; the worker is replaced anyway since it has been signalled.
+					Kill(worker);
+					Complete(worker.mPosition, result);
+					worker.mBusy = false;
+					Dispatch(worker);
+					return;
+				}
+			}
+		}
+
+		Kill(worker);
+		auto result = MakeResult(worker.mPosition, false, TestMethodRunner::DescribeTimeout(worker.mTimeout, stack));
+		result.GetTiming().mMethod.mWallNanoseconds = worker.mTimeout * 1000000ull;
+		Complete(worker.mPosition, result);
+		worker.mBusy = false;
+		Dispatch(worker);
+	}
+
+	void Complete(std::uint32_t position, const TestResult& result)
+	{
+		mResults[position] = result;
+		mCompleted[position] = true;
+		if (!result.GetPassed())
+			++mFailures;
+	}
+
+	void SkipPending()
+	{
+		for (auto position : mPending)
+		{
+			mCompleted[position] = true;
+			mSkipped[position] = true;
+		}
+		mPending.clear();
+	}
+
+	void FailPending(const std::string& description)
+	{
+		while (!mPending.empty())
+		{
+			auto position = mPending.front();
+			mPending.pop_front();
+			Complete(position, MakeResult(position, false, description));
+		}
+	}
+
+	void ReportCompleted(ITestRun& testRun, unsigned long& passedCount, unsigned long& failedCount)
+	{
+		while (mNextReport < mResults.size() && mCompleted[mNextReport])
+		{
+			if (mSkipped[mNextReport])
+			{
+				++mNextReport;
+				continue;
+			}
+			auto& result = mResults[mNextReport++];
+			testRun.OnBeginMethod(result.GetTestMethod());
+			testRun.OnEndMethod(result.GetPassed(), result.GetDescription(), result.GetTiming());
+			if (result.GetPassed())
+				++passedCount;
+			else
+				++failedCount;
+		}
+	}
+
+	TestResult MakeResult(std::uint32_t position, bool passed, const std::string& description) const
+	{
+		auto& factory = *mEntry.mFactory;
+		return TestResult(
+			factory.GetTestClassName(),
+			factory.Get(mEntry.mMethods[position]).GetTestMethodName(),
+			passed,
+			description);
+	}
+
+	TestResult Crashed(std::uint32_t position, int status) const
+	{
+		std::ostringstream out;
+		if (WIFSIGNALED(status))
+			out << "Test process terminated by signal " << WTERMSIG(status)
+				<< " (" << ::strsignal(WTERMSIG(status)) << ").";
+		else if (WIFEXITED(status))
+			out << "Test process exited unexpectedly with code " << WEXITSTATUS(status) << ".";
+		else
+			out << "Test process ended unexpectedly.";
+		return MakeResult(position, false, out.str());
+	}
+
+	bool Start(Worker& worker)
+	{
+		int command[2];
+		int result[2];
+		if (::pipe(command) != 0)
+			return false;
+		if (::pipe(result) != 0)
+		{
+			::close(command[0]);
+			::close(command[1]);
+			return false;
+		}
+
+		std::cout.flush();
+		std::cerr.flush();
+		std::fflush(nullptr);
+		auto process = ::fork();
+		if (process == 0)
+		{
+			::close(command[1]);
+			::close(result[0]);
+			//Other workers' pipes must not stay open in this process or they never see end of file.
+			for (auto& other : mWorkers)
+				if (other.mProcess >= 0)
+				{
+					::close(other.mCommand);
+					::close(other.mResult);
+				}
+			WorkerMain(command[0], result[1]);
+		}
+
+		::close(command[0]);
+		::close(result[1]);
+		if (process < 0)
+		{
+			::close(command[1]);
+			::close(result[0]);
+			return false;
+		}
+
+		worker.mProcess = process;
+		worker.mCommand = command[1];
+		worker.mResult = result[0];
+		return true;
+	}
+
+	void Kill(Worker& worker)
+	{
+		if (worker.mProcess >= 0)
+			::kill(worker.mProcess, SIGKILL);
+		Stop(worker);
+	}
+
+	int Stop(Worker& worker)
+	{
+		int status = 0;
+		if (worker.mProcess < 0)
+			return status;
+		::close(worker.mCommand);
+		::close(worker.mResult);
+		while (::waitpid(worker.mProcess, &status, 0) < 0 && errno == EINTR)
+		{
+		}
+		worker.mProcess = -1;
+		worker.mCommand = -1;
+		worker.mResult = -1;
+		return status;
+	}
+
+	[[noreturn]] void WorkerMain(int command, int result)
+	{
+		::signal(SIGPIPE, SIG_DFL);
+		TestStackTrace::SetFrameDescriptor(result);
+		std::uint32_t position = 0;
+		while (ReadAll(command, &position, sizeof(position)))
+		{
+			auto testResult = TestMethodRunner::RunTestMethod(*mEntry.mFactory, mEntry.mMethods[position], mAllocations, mHardwareCounters, mRepeatCount, mStressThreads);
+			std::cout.flush();
+			std::cerr.flush();
+			std::fflush(nullptr);
+			if (!WriteResult(result, position, testResult))
+				break;
+		}
+		::_exit(0);
+	}
+
+	//Result frame: position, passed flag, timing, description length, description bytes.
+	//The timing is sent member by member since TestTiming is not trivially copyable;
+	//benchmarks never run in worker processes, so mBenchmark is not sent.
+	static bool WriteResult(int descriptor, std::uint32_t position, const TestResult& result)
+	{
+		auto& description = result.GetDescription();
+		auto& timing = result.GetTiming();
+		std::uint8_t passed = result.GetPassed() ? 1 : 0;
+		std::uint32_t length = description.size();
+		std::string frame;
+		Append(frame, position);
+		Append(frame, passed);
+		Append(frame, timing.mBeginTest);
+		Append(frame, timing.mMethod);
+		Append(frame, timing.mEndTest);
+		Append(frame, timing.mAllocations);
+		Append(frame, timing.mCounters);
+		Append(frame, timing.mRepeat);
+		Append(frame, length);
+		frame.append(description);
+		return WriteAll(descriptor, frame.data(), frame.size());
+	}
+
+	template <typename TValue>
+	static void Append(std::string& frame, const TValue& value)
+	{
+		frame.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	//Reads the rest of a result frame whose position has already been read.
+	bool ReadResult(int descriptor, std::uint32_t position, TestResult& result) const
+	{
+		std::uint8_t passed = 0;
+		TestTiming timing;
+		std::uint32_t length = 0;
+		if (!ReadAll(descriptor, &passed, sizeof(passed)) ||
+			!ReadAll(descriptor, &timing.mBeginTest, sizeof(timing.mBeginTest)) ||
+			!ReadAll(descriptor, &timing.mMethod, sizeof(timing.mMethod)) ||
+			!ReadAll(descriptor, &timing.mEndTest, sizeof(timing.mEndTest)) ||
+			!ReadAll(descriptor, &timing.mAllocations, sizeof(timing.mAllocations)) ||
+			!ReadAll(descriptor, &timing.mCounters, sizeof(timing.mCounters)) ||
+			!ReadAll(descriptor, &timing.mRepeat, sizeof(timing.mRepeat)) ||
+			!ReadAll(descriptor, &length, sizeof(length)))
+			return false;
+		std::string description(length, '\0');
+		if (length > 0 && !ReadAll(descriptor, &description[0], length))
+			return false;
+		result = MakeResult(position, passed != 0, description);
+		result.GetTiming() = timing;
+		return true;
+	}
+
+	//Reads the rest of a TestStackTrace frame whose marker has already been read.
+	static std::string ReadStack(int descriptor)
+	{
+		std::uint32_t count = 0;
+		void* frames[TestStackTrace::MaxFrames];
+		if (!ReadAll(descriptor, &count, sizeof(count)) ||
+			count > TestStackTrace::MaxFrames ||
+			!ReadAll(descriptor, frames, count * sizeof(void*)))
+			return std::string();
+		return TestStackTrace::Format(frames, count);
+	}
+
+	static bool ReadAll(int descriptor, void* buffer, std::size_t size)
+	{
+		auto data = reinterpret_cast<char*>(buffer);
+		while (size > 0)
+		{
+			auto count = ::read(descriptor, data, size);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			data += count;
+			size -= count;
+		}
+		return true;
+	}
+
+	static bool WriteAll(int descriptor, const void* buffer, std::size_t size)
+	{
+		auto data = reinterpret_cast<const char*>(buffer);
+		while (size > 0)
+		{
+			auto count = ::write(descriptor, data, size);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			data += count;
+			size -= count;
+		}
+		return true;
+	}
+
+private:
+	const TestPlanClass& mEntry;
+	unsigned long mDefaultTimeout;
+	unsigned long mMaxFailures;
+	TestAllocations::ModeEnum mAllocations;
+	bool mHardwareCounters;
+	unsigned long mRepeatCount;
+	unsigned long mStressThreads;
+	unsigned long mFailures;
+	std::vector<Worker> mWorkers;
+	std::vector<TestResult> mResults;
+	std::vector<bool> mCompleted;
+	std::vector<bool> mSkipped;
+	std::deque<std::uint32_t> mPending;
+	unsigned long mNextReport;
+};
+
+}
+
+#endif
@@ -1,12 +1,12 @@
 #pragma once
 #include <vector>
-#include <list>
-#include <map>
+#include <memory>
 #include <typeinfo>
 #include <exception>
 #include <sstream>
 #include <type_traits>
 #include <tuple>
+#include <array>
 #include "Const.h"
 #include "ForcedCast.h"
 #include "VirtualTable.h"
@@ -14,6 +14,7 @@
 #include "ReturnValue.h"
 #include "Any.h"
 #include "CallData.h"
+#include "CallTable.h"
 #include "SetupData.h"
 #include "ArgumentList.h"
 #include "FunctionHelper.h"
@@ -50,17 +51,20 @@ public:
 		bool failed = false;
 		std::ostringstream out;
 		out << "Mock<" << TypeName<T>::Get() << ">::Verify: the following setups were not matched." << std::endl;
-		for (auto mapIter = mCallMap.begin(), mapEnd = mCallMap.end(); mapIter != mapEnd; ++mapIter)
+		for (unsigned long offset = 0; offset < MAX_VIRTUAL_FUNCTIONS; ++offset)
 		{
-			for (auto listIter = mapIter->second.begin(), listEnd = mapIter->second.end(); listIter != listEnd; ++listIter)
+			if (!mCallTables[offset])
+				continue;
+			auto& callTable = *mCallTables[offset];
+			for (auto listIter = callTable.GetCalls().begin(), listEnd = callTable.GetCalls().end(); listIter != listEnd; ++listIter)
 			{
 				if (listIter->mExpectedCalls != listIter->mActualCalls)
 				{
 					failed = true;
-					out << "Offset " << mapIter->first << " with signature " << mCallSignature[mapIter->first]
-						<< " expected " << listIter->mExpectedCalls << ", actual " << listIter->mActualCalls << std::endl;
+					out << "Offset " << offset << " with signature " << callTable.GetSignature()
+						<< " expected " << listIter->mExpectedCalls << ", actual " << listIter->mActualCalls.load() << std::endl;
 					if (!listIter->mArguments.empty())
-						out << "Match arguments: " << FormatArgumentList(listIter->mArguments) << std::endl;
+						out << "Match arguments: " << FormatArgumentList(listIter->mArguments.data(), listIter->mArguments.size()) << std::endl;
 				}
 			}
 		}
@@ -75,52 +79,53 @@ public:
 		throw TestException(out.str());
 	}
 
+	//Called by the mocked functions.  It only reads the setups and counts the calls
+	//atomically, so the mocked object may be used on several threads at once; the setups
+	//must be made before those threads use it and Verify called after they are done.
 	template <typename TResult, typename... TArgs>
 	void Invoke(unsigned long index, ReturnValue<TResult>& returnValue, TArgs... args)
 	{
-		auto mapIter = mCallMap.find(index);
-		if (mapIter == mCallMap.end())
+		if (index >= MAX_VIRTUAL_FUNCTIONS || !mCallTables[index])
 			throw TestException("Mock<T>::Invoke: Invalid callback index.");
+		auto& callTable = *mCallTables[index];
 
-		ArgumentList arguments;
-		BuildArgumentList<TArgs...>::Build(arguments, args...);
+		std::array<Any, sizeof...(TArgs)> arguments;
+		BuildArgumentList<TArgs...>::Build(arguments.data(), args...);
 
-		for (auto listIter = mapIter->second.begin(), last = mapIter->second.end(); listIter != last; ++listIter)
+		CallData* callData = callTable.Find(arguments.data(), arguments.size());
+		if (callData != nullptr)
 		{
-			if (listIter->mArguments == arguments)
-			{
-				++listIter->mActualCalls;
-				listIter->DoCallback<TArgs...>(args...);
-				listIter->mThrowValue.Throw();
-				returnValue.Set(listIter->mReturnValue);
-				return;
-			}
+			++callData->mActualCalls;
+			callData->DoCallback<TArgs...>(args...);
+			callData->mThrowValue.Throw();
+			returnValue.Set(callData->mReturnValue);
+			return;
 		}
 
 		std::ostringstream out;
 		out << "Mock<" << TypeName<T>::Get() << ">::Invoke: no matching setup for function at offset "
-			<< index << " with signature " << mCallSignature[index] << " and arguments:" << std::endl
-			<< FormatArgumentList(arguments);
+			<< index << " with signature " << callTable.GetSignature() << " and arguments:" << std::endl
+			<< FormatArgumentList(arguments.data(), arguments.size());
 		throw TestException(out.str());
 	}
 
 private:
-	static std::string FormatArgumentList(const std::vector<Any>& arguments)
+	static std::string FormatArgumentList(const Any* arguments, std::size_t count)
 	{
 		std::ostringstream out;
-		for (auto begin = arguments.begin(), iter = begin, end = arguments.end(); iter != end; ++iter)
+		for (std::size_t index = 0; index < count; ++index)
 		{
-			if (iter != begin)
+			if (index != 0)
 				out << ", ";
-			out << iter->ToString();
+			out << arguments[index].ToString();
 		}
 		return out.str();
 	}
 
 private:
 	VirtualTable mTable;
-	std::map<unsigned long, std::list<CallData>> mCallMap;
-	std::map<unsigned long, std::string> mCallSignature;
+	//The setups of each virtual function indexed by its v-table offset.
+	std::unique_ptr<CallTable> mCallTables[MAX_VIRTUAL_FUNCTIONS];
 };
 
 template <typename T, unsigned long I>
@@ -274,13 +279,12 @@ inline auto Mock<T>::Setup(TFunction function, TParams... params) ->
 	CallData callData(offset);
 	PackParameters<ArgsTuple, 0, TParams...>::Pack(callData, params...);
 
-	mCallSignature[offset] = TypeName<TFunction>::Get();
-
-	auto& callList = mCallMap[offset];
+	auto& callTable = mCallTables[offset];
+	if (!callTable)
+		callTable.reset(new CallTable(TypeName<TFunction>::Get()));
 	if (ArgumentCount == 0)
-		callList.clear();
-	callList.push_back(callData);
-	return SetupData<Result, CallbackFunctionType>(callList.back());
+		callTable->Clear();
+	return SetupData<Result, CallbackFunctionType>(callTable->Add(callData));
 }
 
 }
@@ -0,0 +1,292 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "ITestRun.h"
+#include "RunOptions.h"
+#include "TestPlan.h"
+#include "TestResult.h"
+#include "TestMethodRunner.h"
+#include "TestThreadPool.h"
+#include "TestWatchdog.h"
+#include "TestStackTrace.h"
+
+namespace UnitTest
+{
+
+// ParallelTestRunner runs a TestPlan on a TestThreadPool.  Each test class is
+// scheduled as an InitializeTests task that, on success, fans its test methods out
+// as individual tasks; the task that completes the last method of a class runs
+// TerminateTests.  Results are buffered per class and reported to the ITestRun
+// under a single lock in plan order, so reporters see the same begin/end class
+// sequence they would see from a sequential run.
+//
+// A test method with a timeout (see TestMethodRunner::GetTimeout) is watched by a
+// TestWatchdog.  When it expires the method fails with the stack of the hung thread,
+// the thread is abandoned (it keeps running until it returns or the process exits)
+// and the pool continues on a replacement thread.
+//
+// With RunOptions::mFailFast no further test class or test method is started once
+// that many failures have been recorded; methods already running still complete and
+// classes that were initialized are still terminated.  Skipped work is not reported.
+class ParallelTestRunner
+{
+public:
+	static void Run(
+		ITestRun& testRun,
+		const TestPlan& plan,
+		const RunOptions& options,
+		unsigned long threadCount,
+		unsigned long& passedCount,
+		unsigned long& failedCount)
+	{
+		ParallelTestRunner runner(testRun, plan, options, passedCount, failedCount);
+		TestThreadPool pool(threadCount);
+		TestWatchdog watchdog;
+		runner.mWatchdog = &watchdog;
+		for (auto index = 0ul; index < runner.mClasses.size(); ++index)
+			pool.Push([&runner, &pool, index]() { runner.InitializeClass(pool, index); });
+		pool.Wait();
+	}
+
+private:
+	class ClassRun
+	{
+	public:
+		ClassRun(const TestPlanClass& entry)
+			: mEntry(entry),
+			mResults(entry.mMethods.size()),
+			mRan(entry.mMethods.size(), 0),
+			mRemaining(entry.mMethods.size()),
+			mSkipped(false),
+			mCompleted(false)
+		{
+		}
+
+		const TestPlanClass& mEntry;
+		TestResult mInitialize;
+		std::vector<TestResult> mResults;
+		//Not a vector<bool> since methods of one class complete concurrently.
+		std::vector<unsigned char> mRan;
+		TestResult mTerminate;
+		std::atomic<unsigned long> mRemaining;
+		bool mSkipped;
+		bool mCompleted;
+	};
+
+	//Decides whether the test thread or the watchdog completes a watched test method.
+	class WatchState
+	{
+	public:
+		WatchState()
+			: mClaimed(false), mAbandoned(false)
+		{
+		}
+
+		std::atomic<bool> mClaimed;
+		std::mutex mMutex;
+		std::condition_variable mChanged;
+		bool mAbandoned;
+	};
+
+	ParallelTestRunner(ITestRun& testRun, const TestPlan& plan, const RunOptions& options, unsigned long& passedCount, unsigned long& failedCount)
+		: mTestRun(testRun),
+		mPassedCount(passedCount),
+		mFailedCount(failedCount),
+		mDefaultTimeout(options.mTimeoutMilliseconds),
+		mFailFast(options.mFailFast),
+		mAllocations(options.mAllocations),
+		mHardwareCounters(options.mHardwareCounters),
+		mRepeatCount(options.mRepeatCount),
+		mStressThreads(options.mStressThreads),
+		mFailures(0),
+		mWatchdog(nullptr),
+		mNextReport(0)
+	{
+		for (auto index = 0ul; index < plan.GetCount(); ++index)
+			mClasses.push_back(std::unique_ptr<ClassRun>(new ClassRun(plan.Get(index))));
+	}
+
+	void InitializeClass(TestThreadPool& pool, unsigned long classIndex)
+	{
+		auto& classRun = *mClasses[classIndex];
+		auto& factory = *classRun.mEntry.mFactory;
+		if (IsStopping())
+		{
+			classRun.mSkipped = true;
+			CompleteClass(classIndex);
+			return;
+		}
+		classRun.mInitialize = TestMethodRunner::InitializeTests(factory);
+		if (!classRun.mInitialize.GetPassed())
+			mFailures += classRun.mResults.size() + 1;
+		if (!classRun.mInitialize.GetPassed() || classRun.mResults.empty())
+		{
+			TerminateClass(classIndex);
+			return;
+		}
+
+		//Pushed in reverse so the owning worker pops them in declaration order.
+		for (auto position = classRun.mResults.size(); position-- > 0;)
+			pool.Push([this, &pool, classIndex, position]() { RunMethod(pool, classIndex, position); });
+	}
+
+	void RunMethod(TestThreadPool& pool, unsigned long classIndex, unsigned long position)
+	{
+		auto& classRun = *mClasses[classIndex];
+		auto& factory = *classRun.mEntry.mFactory;
+		auto index = classRun.mEntry.mMethods[position];
+		if (IsStopping())
+		{
+			SkipMethod(classIndex);
+			return;
+		}
+		auto timeout = TestMethodRunner::GetTimeout(factory, index, mDefaultTimeout);
+		if (timeout == 0)
+		{
+			CompleteMethod(classIndex, position, TestMethodRunner::RunTestMethod(factory, index, mAllocations, mHardwareCounters, mRepeatCount, mStressThreads));
+			return;
+		}
+
+		auto state = std::make_shared<WatchState>();
+		auto worker = pool.GetCurrentWorker();
+		auto thread = TestStackTrace::GetCurrentThread();
+		auto watch = mWatchdog->Watch(timeout, [this, &pool, classIndex, position, timeout, worker, thread, state]()
+		{
+			TimedOut(pool, classIndex, position, timeout, worker, thread, *state);
+		});
+		auto result = TestMethodRunner::RunTestMethod(factory, index, mAllocations, mHardwareCounters, mRepeatCount, mStressThreads);
+		if (state->mClaimed.exchange(true))
+		{
+			//The watchdog already failed this method; once this thread has been abandoned
+			//it must not touch the runner, which may be gone by then.
+			std::unique_lock<std::mutex> lock(state->mMutex);
+			state->mChanged.wait(lock, [&]() { return state->mAbandoned; });
+			return;
+		}
+		mWatchdog->Cancel(watch);
+		CompleteMethod(classIndex, position, result);
+	}
+
+	void TimedOut(
+		TestThreadPool& pool,
+		unsigned long classIndex,
+		unsigned long position,
+		unsigned long timeout,
+		unsigned long worker,
+		TestStackTrace::ThreadHandle thread,
+		WatchState& state)
+	{
+		if (state.mClaimed.exchange(true))
+			return;
+
+		auto& entry = mClasses[classIndex]->mEntry;
+		TestResult result(
+			entry.mFactory->GetTestClassName(),
+			entry.mFactory->Get(entry.mMethods[position]).GetTestMethodName(),
+			false,
+			TestMethodRunner::DescribeTimeout(timeout, TestStackTrace::Capture(thread)));
+		result.GetTiming().mMethod.mWallNanoseconds = timeout * 1000000ull;
+
+		//Pushed before abandoning the worker so that the pool never looks idle in between.
+		pool.Push([this, classIndex, position, result]() { CompleteMethod(classIndex, position, result); });
+		pool.Abandon(worker);
+
+		std::lock_guard<std::mutex> lock(state.mMutex);
+		state.mAbandoned = true;
+		state.mChanged.notify_all();
+	}
+
+	void CompleteMethod(unsigned long classIndex, unsigned long position, const TestResult& result)
+	{
+		auto& classRun = *mClasses[classIndex];
+		classRun.mResults[position] = result;
+		classRun.mRan[position] = 1;
+		if (!result.GetPassed())
+			++mFailures;
+		if (--classRun.mRemaining == 0)
+			TerminateClass(classIndex);
+	}
+
+	void SkipMethod(unsigned long classIndex)
+	{
+		if (--mClasses[classIndex]->mRemaining == 0)
+			TerminateClass(classIndex);
+	}
+
+	bool IsStopping() const
+	{
+		return mFailFast != 0 && mFailures >= mFailFast;
+	}
+
+	void TerminateClass(unsigned long classIndex)
+	{
+		auto& classRun = *mClasses[classIndex];
+		classRun.mTerminate = TestMethodRunner::TerminateTests(*classRun.mEntry.mFactory);
+		if (!classRun.mTerminate.GetPassed())
+			++mFailures;
+		CompleteClass(classIndex);
+	}
+
+	void CompleteClass(unsigned long classIndex)
+	{
+		auto& classRun = *mClasses[classIndex];
+		std::lock_guard<std::mutex> lock(mReportMutex);
+		classRun.mCompleted = true;
+		while (mNextReport < mClasses.size() && mClasses[mNextReport]->mCompleted)
+			ReportClass(*mClasses[mNextReport++]);
+	}
+
+	void ReportClass(const ClassRun& classRun)
+	{
+		if (classRun.mSkipped)
+			return;
+		auto& factory = *classRun.mEntry.mFactory;
+		unsigned long count = classRun.mResults.size();
+		mTestRun.OnBeginClass(factory.GetTestClassName(), count);
+
+		Report(classRun.mInitialize);
+		if (!classRun.mInitialize.GetPassed())
+			mFailedCount += count + 1;
+		else
+			for (auto position = 0ul; position < count; ++position)
+				if (!classRun.mRan[position])
+					continue;
+				else if (Report(classRun.mResults[position]))
+					++mPassedCount;
+				else
+					++mFailedCount;
+
+		if (!Report(classRun.mTerminate))
+			++mFailedCount;
+
+		mTestRun.OnEndClass();
+	}
+
+	bool Report(const TestResult& result)
+	{
+		mTestRun.OnBeginMethod(result.GetTestMethod());
+		mTestRun.OnEndMethod(result.GetPassed(), result.GetDescription(), result.GetTiming());
+		return result.GetPassed();
+	}
+
+private:
+	ITestRun& mTestRun;
+	unsigned long& mPassedCount;
+	unsigned long& mFailedCount;
+	unsigned long mDefaultTimeout;
+	unsigned long mFailFast;
+	TestAllocations::ModeEnum mAllocations;
+	bool mHardwareCounters;
+	unsigned long mRepeatCount;
+	unsigned long mStressThreads;
+	std::atomic<unsigned long> mFailures;
+	TestWatchdog* mWatchdog;
+	std::vector<std::unique_ptr<ClassRun>> mClasses;
+	std::mutex mReportMutex;
+	unsigned long mNextReport;
+};
+
+}
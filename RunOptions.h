@@ -0,0 +1,170 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "TestDurations.h"
+#include "TestFailures.h"
+#include "TestAllocations.h"
+#include "TestCoverageMap.h"
+#include "TestBenchmarkBaseline.h"
+
+namespace UnitTest
+{
+
+// RunOptions controls how TestRunner::RunTests schedules the unit tests.
+//
+// Example:
+//	UnitTest::RunOptions options;
+//	options.mThreadCount = 8;
+//	UnitTest::TestRunner::RunTests(writer, options);
+class RunOptions
+{
+public:
+	RunOptions()
+		: mThreadCount(1),
+		mIsolateProcesses(false),
+		mShardIndex(0),
+		mShardCount(1),
+		mDurationsFile(TestDurations::GetDefaultFileName()),
+		mRecordHistory(false),
+		mHistoryWindow(20),
+		mRegressionThreshold(3.0),
+		mTimeoutMilliseconds(0),
+		mFailuresFile(TestFailures::GetDefaultFileName()),
+		mRecordFailures(false),
+		mFailedFirst(false),
+		mFailFast(0),
+		mAllocations(TestAllocations::Off),
+		mHardwareCounters(false),
+		mCoverageFile(TestCoverageMap::GetDefaultFileName()),
+		mRecordCoverage(false),
+		mCoverageDirectory("."),
+		mImpactedOnly(false),
+		mRepeatCount(1),
+		mStressThreads(1),
+		mShuffle(false),
+		mShuffleSeed(0),
+		mBenchmarks(false),
+		mBenchmarkSamples(10),
+		mBenchmarkSampleMilliseconds(10),
+		mBenchmarkWarmupMilliseconds(100),
+		mBaselineFile(TestBenchmarkBaseline::GetDefaultFileName()),
+		mSaveBaseline(false),
+		mCompareBaseline(false),
+		mMaxRegression(0.05),
+		mRegressionConfidence(0.95)
+	{
+	}
+
+	//Number of worker threads used to run test methods.
+	//1 runs every test on the calling thread, 0 uses one thread per hardware thread.
+	unsigned long mThreadCount;
+
+	//Runs each test method in a forked worker process (not available on Windows).
+	//Workers are forked after InitializeTests and mThreadCount workers are used per test class.
+	bool mIsolateProcesses;
+
+	//Name patterns of the unit tests to run and to skip (see TestFilter).  Test classes
+	//without any selected unit test are skipped, including InitializeTests and TerminateTests.
+	std::vector<std::string> mIncludes;
+	std::vector<std::string> mExcludes;
+
+	//Runs only the unit tests assigned to shard mShardIndex of mShardCount (see TestShard).
+	unsigned long mShardIndex;
+	unsigned long mShardCount;
+
+	//Recorded unit test durations used to balance the shards (ignored if the file does not exist).
+	std::string mDurationsFile;
+
+	//Appends the duration of every passed unit test to mDurationsFile (keeping the newest
+	//mHistoryWindow durations per unit test) and warns about unit tests that are more than
+	//mRegressionThreshold standard deviations slower than their recorded history.
+	bool mRecordHistory;
+	unsigned long mHistoryWindow;
+	double mRegressionThreshold;
+
+	//Fails any test method running longer than this (0 disables), unless the test method or
+	//its test class declares its own timeout (see TEST_METHOD_TIMEOUT and GetTimeoutMilliseconds).
+	unsigned long mTimeoutMilliseconds;
+
+	//File holding the unit tests that failed in the previous run (see TestFailures).
+	std::string mFailuresFile;
+
+	//Updates mFailuresFile with the results of this run.
+	bool mRecordFailures;
+
+	//Runs the unit tests listed in mFailuresFile (and their test classes) first.
+	//Implies mRecordFailures.
+	bool mFailedFirst;
+
+	//Stops starting new unit tests once this many have failed (0 runs every unit test).
+	//Test classes that were initialized are still terminated.
+	unsigned long mFailFast;
+
+	//Counts the heap allocations of every unit test (TestAllocations::Count) and optionally
+	//fails unit tests that do not free them (TestAllocations::FailOnLeaks).  Requires
+	//UNIT_TEST_ALLOCATION_TRACKING() in one source file of the test executable.
+	TestAllocations::ModeEnum mAllocations;
+
+	//Counts CPU cycles, instructions, cache and branch misses of every test method (and of
+	//the timed samples of every benchmark) with perf_event_open (see TestHardwareCounters).
+	//Ignored, with a warning, where the counters are unavailable.
+	bool mHardwareCounters;
+
+	//File mapping every unit test to the source files it executed (see TestCoverageMap).
+	std::string mCoverageFile;
+
+	//Records the source files executed by every unit test into mCoverageFile.  Requires a
+	//test executable built with --coverage, UNIT_TEST_COVERAGE() in one of its source files
+	//and its .gcda files below mCoverageDirectory.
+	//Unit tests then run one at a time on the calling thread, without timeouts.
+	bool mRecordCoverage;
+	std::string mCoverageDirectory;
+
+	//Runs only the unit tests whose recorded source files, or whose own source file, are
+	//in mChangedFiles, plus the unit tests without recorded coverage.
+	bool mImpactedOnly;
+	std::vector<std::string> mChangedFiles;
+
+	//Runs every selected unit test mRepeatCount times, spread over mStressThreads threads
+	//running the same unit test at the same time, each run with a new test class instance.
+	//A repeated unit test is reported once, with TestTiming::mRepeat holding its pass
+	//rate and duration distribution; it passes only if every run passed.
+	unsigned long mRepeatCount;
+	unsigned long mStressThreads;
+
+	//Runs the test classes, and the unit tests within each test class, in a random order
+	//derived from mShuffleSeed (0 picks a new seed, which is reported with OnMessage so that
+	//the order can be replayed).
+	bool mShuffle;
+	unsigned long long mShuffleSeed;
+
+	//Runs the BENCHMARK_METHODs instead of the unit tests, one at a time on the calling
+	//thread: each is calibrated to loop for at least mBenchmarkSampleMilliseconds per sample,
+	//warmed up for mBenchmarkWarmupMilliseconds and then timed over mBenchmarkSamples samples
+	//(see TestMethodRunner::RunBenchmarkMethod).  Threads, isolation, timeouts, repetitions
+	//and allocation tracking do not apply to benchmarks.
+	bool mBenchmarks;
+	unsigned long mBenchmarkSamples;
+	unsigned long mBenchmarkSampleMilliseconds;
+	unsigned long mBenchmarkWarmupMilliseconds;
+
+	//File holding the benchmark samples of a previous run (see TestBenchmarkBaseline).
+	std::string mBaselineFile;
+
+	//Replaces the samples of every passed benchmark in mBaselineFile.
+	bool mSaveBaseline;
+
+	//Compares every benchmark with its samples in mBaselineFile and fails it if its median
+	//is more than mMaxRegression (a fraction) slower with at least mRegressionConfidence
+	//confidence (see TestBenchmarkRecorder).
+	bool mCompareBaseline;
+	double mMaxRegression;
+	double mRegressionConfidence;
+
+	//Files that RunTestsFromCommandLine writes JUnit XML and JSON lines reports to
+	//in addition to the console output (empty for none).
+	std::string mJUnitFile;
+	std::string mJsonFile;
+};
+
+}
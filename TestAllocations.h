@@ -0,0 +1,324 @@
+#pragma once
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+namespace UnitTest
+{
+
+// TestAllocationCounts is the heap usage of one unit test: the number and size of the
+// allocations it made, how many of those were freed again (on any thread) and the peak
+// number of live bytes.  Allocations that were not freed are GetLeakedAllocations().
+// mCounted is false when allocation tracking was off for the unit test.
+class TestAllocationCounts
+{
+public:
+	TestAllocationCounts()
+		: mCounted(false),
+		mAllocations(0),
+		mDeallocations(0),
+		mAllocatedBytes(0),
+		mDeallocatedBytes(0),
+		mPeakLiveBytes(0)
+	{
+	}
+
+	unsigned long long GetLeakedAllocations() const
+	{
+		return mAllocations > mDeallocations ? mAllocations - mDeallocations : 0;
+	}
+
+	unsigned long long GetLeakedBytes() const
+	{
+		return mAllocatedBytes > mDeallocatedBytes ? mAllocatedBytes - mDeallocatedBytes : 0;
+	}
+
+	bool mCounted;
+	unsigned long long mAllocations;
+	unsigned long long mDeallocations;
+	unsigned long long mAllocatedBytes;
+	unsigned long long mDeallocatedBytes;
+	unsigned long long mPeakLiveBytes;
+};
+
+// TestAllocations counts the global operator new/delete calls made by a unit test.
+// The replacement operators are only defined where UNIT_TEST_ALLOCATION_TRACKING()
+// is expanded, which must happen at global scope in exactly one source file of the
+// test executable:
+//
+//	#include "UnitTest.h"
+//	UNIT_TEST_ALLOCATION_TRACKING()
+//
+// Every block carries a small header recording its size and the unit test (if any)
+// that allocated it, so a block freed on another thread is still credited to the
+// unit test that allocated it.  Only allocations made on the thread running the unit
+// test are counted, and none while a TestAllocationPause is alive on that thread.
+class TestAllocations
+{
+public:
+	enum ModeEnum
+	{
+		Off,
+		Count,
+		FailOnLeaks
+	};
+
+	//Returns true if UNIT_TEST_ALLOCATION_TRACKING() is expanded in this executable.
+	static bool IsInstalled()
+	{
+		return GetInstalled();
+	}
+
+	static bool Install()
+	{
+		GetInstalled() = true;
+		return true;
+	}
+
+	//Starts counting the allocations of the calling thread.
+	static void Begin()
+	{
+		auto& thread = GetThread();
+		if (thread.mSlot == 0)
+			thread.mSlot = static_cast<std::uint32_t>(GetNextSlot()++ % MaxSlots) + 1;
+		thread.mTag = ++GetNextTag();
+		auto& slot = GetSlots()[thread.mSlot - 1];
+		slot.mTag = thread.mTag;
+		slot.mAllocations = 0;
+		slot.mDeallocations = 0;
+		slot.mAllocatedBytes = 0;
+		slot.mDeallocatedBytes = 0;
+		thread.mLiveBytes = 0;
+		thread.mPeakLiveBytes = 0;
+		thread.mActive = true;
+	}
+
+	//Stops counting and returns the counts since Begin.
+	static TestAllocationCounts End()
+	{
+		auto& thread = GetThread();
+		thread.mActive = false;
+		TestAllocationCounts counts;
+		if (thread.mSlot == 0)
+			return counts;
+		auto& slot = GetSlots()[thread.mSlot - 1];
+		counts.mCounted = true;
+		counts.mAllocations = slot.mAllocations;
+		counts.mDeallocations = slot.mDeallocations;
+		counts.mAllocatedBytes = slot.mAllocatedBytes;
+		counts.mDeallocatedBytes = slot.mDeallocatedBytes;
+		counts.mPeakLiveBytes = thread.mPeakLiveBytes;
+		slot.mTag = 0;
+		return counts;
+	}
+
+	static void Pause()
+	{
+		++GetThread().mPaused;
+	}
+
+	static void Resume()
+	{
+		--GetThread().mPaused;
+	}
+
+	//Called by the replacement operator new; throws std::bad_alloc unless nothrow.
+	static void* Allocate(std::size_t size, bool nothrow)
+	{
+		for (;;)
+		{
+			auto block = std::malloc(size + HeaderSize);
+			if (block != nullptr)
+			{
+				auto header = static_cast<Header*>(block);
+				header->mSize = size;
+				header->mSlot = 0;
+				header->mTag = 0;
+				auto& thread = GetThread();
+				if (thread.mActive && thread.mPaused == 0)
+					Record(thread, *header);
+				return static_cast<char*>(block) + HeaderSize;
+			}
+			auto handler = std::get_new_handler();
+			if (handler == nullptr)
+			{
+				if (nothrow)
+					return nullptr;
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	//Called by the replacement operator delete.
+	static void Deallocate(void* pointer)
+	{
+		if (pointer == nullptr)
+			return;
+		auto header = reinterpret_cast<Header*>(static_cast<char*>(pointer) - HeaderSize);
+		if (header->mSlot != 0)
+		{
+			auto& slot = GetSlots()[header->mSlot - 1];
+			if (slot.mTag == header->mTag)
+			{
+				++slot.mDeallocations;
+				slot.mDeallocatedBytes += header->mSize;
+				auto& thread = GetThread();
+				if (thread.mSlot == header->mSlot && thread.mLiveBytes >= header->mSize)
+					thread.mLiveBytes -= header->mSize;
+			}
+		}
+		std::free(header);
+	}
+
+private:
+	static const std::size_t HeaderSize = 32;
+	static const unsigned long MaxSlots = 1024;
+
+	class Header
+	{
+	public:
+		std::size_t mSize;
+		std::uint32_t mSlot;
+		std::uint64_t mTag;
+	};
+	static_assert(sizeof(Header) <= HeaderSize && HeaderSize % alignof(std::max_align_t) == 0, "invalid allocation header size");
+
+	//Counters of the unit test running on one thread; updated by any thread that frees its blocks.
+	class Slot
+	{
+	public:
+		std::atomic<std::uint64_t> mTag;
+		std::atomic<unsigned long long> mAllocations;
+		std::atomic<unsigned long long> mDeallocations;
+		std::atomic<unsigned long long> mAllocatedBytes;
+		std::atomic<unsigned long long> mDeallocatedBytes;
+	};
+
+	//Trivially constructible so that it needs no dynamic initialization inside operator new.
+	class Thread
+	{
+	public:
+		std::uint32_t mSlot;
+		std::uint64_t mTag;
+		bool mActive;
+		unsigned long mPaused;
+		unsigned long long mLiveBytes;
+		unsigned long long mPeakLiveBytes;
+	};
+
+	static void Record(Thread& thread, Header& header)
+	{
+		auto& slot = GetSlots()[thread.mSlot - 1];
+		header.mSlot = thread.mSlot;
+		header.mTag = thread.mTag;
+		++slot.mAllocations;
+		slot.mAllocatedBytes += header.mSize;
+		thread.mLiveBytes += header.mSize;
+		if (thread.mLiveBytes > thread.mPeakLiveBytes)
+			thread.mPeakLiveBytes = thread.mLiveBytes;
+	}
+
+	static bool& GetInstalled()
+	{
+		static bool installed = false;
+		return installed;
+	}
+
+	static Thread& GetThread()
+	{
+		static thread_local Thread thread;
+		return thread;
+	}
+
+	static Slot* GetSlots()
+	{
+		static Slot slots[MaxSlots];
+		return slots;
+	}
+
+	static std::atomic<unsigned long>& GetNextSlot()
+	{
+		static std::atomic<unsigned long> next(0);
+		return next;
+	}
+
+	static std::atomic<std::uint64_t>& GetNextTag()
+	{
+		static std::atomic<std::uint64_t> next(0);
+		return next;
+	}
+};
+
+// TestAllocationPause excludes the allocations made on the calling thread during its
+// lifetime from the running unit test's counts (e.g. singletons created on first use).
+class TestAllocationPause
+{
+public:
+	TestAllocationPause()
+	{
+		TestAllocations::Pause();
+	}
+
+	~TestAllocationPause()
+	{
+		TestAllocations::Resume();
+	}
+
+	TestAllocationPause(const TestAllocationPause& rhs) = delete;
+	TestAllocationPause& operator=(const TestAllocationPause& rhs) = delete;
+};
+
+}
+
+//Defines the replacement global operator new/delete that count unit test allocations.
+#define UNIT_TEST_ALLOCATION_TRACKING() \
+	void* operator new(std::size_t size) \
+	{ \
+		return UnitTest::TestAllocations::Allocate(size, false); \
+	} \
+	void* operator new[](std::size_t size) \
+	{ \
+		return UnitTest::TestAllocations::Allocate(size, false); \
+	} \
+	void* operator new(std::size_t size, const std::nothrow_t&) noexcept \
+	{ \
+		try \
+		{ \
+			return UnitTest::TestAllocations::Allocate(size, true); \
+		} \
+		catch (...) \
+		{ \
+			return nullptr; \
+		} \
+	} \
+	void* operator new[](std::size_t size, const std::nothrow_t&) noexcept \
+	{ \
+		try \
+		{ \
+			return UnitTest::TestAllocations::Allocate(size, true); \
+		} \
+		catch (...) \
+		{ \
+			return nullptr; \
+		} \
+	} \
+	void operator delete(void* pointer) noexcept \
+	{ \
+		UnitTest::TestAllocations::Deallocate(pointer); \
+	} \
+	void operator delete[](void* pointer) noexcept \
+	{ \
+		UnitTest::TestAllocations::Deallocate(pointer); \
+	} \
+	void operator delete(void* pointer, const std::nothrow_t&) noexcept \
+	{ \
+		UnitTest::TestAllocations::Deallocate(pointer); \
+	} \
+	void operator delete[](void* pointer, const std::nothrow_t&) noexcept \
+	{ \
+		UnitTest::TestAllocations::Deallocate(pointer); \
+	} \
+	static const bool UnitTestAllocationTrackingInstalled = UnitTest::TestAllocations::Install();
@@ -0,0 +1,155 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+namespace UnitTest
+{
+
+// TestBenchmarkBaseline holds the samples (nanoseconds per iteration) of benchmarks keyed
+// by "ClassName.MethodName", in the same format as TestDurations: one line per benchmark
+// containing the class name, the method name and its samples separated by whitespace:
+//
+//	ParserTest ParseNumber 21.3 21.1 20.9 21.4
+class TestBenchmarkBaseline
+{
+public:
+	static const char* GetDefaultFileName()
+	{
+		return "TestBenchmarks.txt";
+	}
+
+	//Returns false if the file could not be opened (the baseline is left empty).
+	bool Load(const std::string& fileName)
+	{
+		std::ifstream in(fileName.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			std::istringstream fields(line);
+			std::string className;
+			std::string methodName;
+			if (!(fields >> className >> methodName))
+				continue;
+			auto& entry = mEntries[className + "." + methodName];
+			entry.mClassName = className;
+			entry.mMethodName = methodName;
+			double value = 0;
+			while (fields >> value)
+				entry.mSamples.push_back(value);
+		}
+		return true;
+	}
+
+	//The file is written to a temporary file first so that an interrupted run never truncates it.
+	bool Save(const std::string& fileName) const
+	{
+		auto temporaryName = fileName + ".tmp";
+		{
+			std::ofstream out(temporaryName.c_str());
+			if (!out)
+				return false;
+			out.precision(9);
+			for (auto& item : mEntries)
+			{
+				if (item.second.mSamples.empty())
+					continue;
+				out << item.second.mClassName << " " << item.second.mMethodName;
+				for (auto sample : item.second.mSamples)
+					out << " " << sample;
+				out << '\n';
+			}
+			if (!out)
+				return false;
+		}
+		std::remove(fileName.c_str());
+		return std::rename(temporaryName.c_str(), fileName.c_str()) == 0;
+	}
+
+	//Replaces the samples of the benchmark.
+	void Set(const std::string& className, const std::string& methodName, const std::vector<double>& samples)
+	{
+		auto& entry = mEntries[className + "." + methodName];
+		entry.mClassName = className;
+		entry.mMethodName = methodName;
+		entry.mSamples = samples;
+	}
+
+	const std::vector<double>* Find(const std::string& className, const std::string& methodName) const
+	{
+		auto iter = mEntries.find(className + "." + methodName);
+		return iter == mEntries.end() || iter->second.mSamples.empty() ? nullptr : &iter->second.mSamples;
+	}
+
+	static double GetMedian(std::vector<double> samples)
+	{
+		if (samples.empty())
+			return 0;
+		std::sort(samples.begin(), samples.end());
+		auto middle = samples.size() / 2;
+		return samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+	}
+
+	//Mann-Whitney U test: returns the confidence (1 - one-sided p-value) that the samples of
+	//current are typically larger (slower is true) or smaller (slower is false) than those of
+	//baseline.  Uses the normal approximation with tie and continuity correction, which needs
+	//about 8 samples on each side to be meaningful.
+	static double GetConfidence(const std::vector<double>& baseline, const std::vector<double>& current, bool slower)
+	{
+		if (baseline.empty() || current.empty())
+			return 0;
+		std::vector<std::pair<double, bool>> values;
+		for (auto value : baseline)
+			values.push_back(std::make_pair(value, false));
+		for (auto value : current)
+			values.push_back(std::make_pair(value, true));
+		std::sort(values.begin(), values.end());
+
+		//Tied values get the average of their ranks.
+		double currentRanks = 0;
+		double ties = 0;
+		for (std::size_t first = 0, last = 0; first < values.size(); first = last)
+		{
+			while (last < values.size() && values[last].first == values[first].first)
+				++last;
+			auto rank = (first + 1 + last) / 2.0;
+			for (auto index = first; index < last; ++index)
+				if (values[index].second)
+					currentRanks += rank;
+			double count = last - first;
+			ties += count * count * count - count;
+		}
+
+		double n1 = baseline.size();
+		double n2 = current.size();
+		double n = n1 + n2;
+		auto u = currentRanks - n2 * (n2 + 1) / 2;
+		auto mean = n1 * n2 / 2;
+		auto variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)));
+		if (variance <= 0)
+			return 0.5;
+		auto z = ((slower ? u - mean : mean - u) - 0.5) / std::sqrt(variance);
+		return 0.5 * std::erfc(-z / std::sqrt(2.0));
+	}
+
+private:
+	class Entry
+	{
+	public:
+		std::string mClassName;
+		std::string mMethodName;
+		std::vector<double> mSamples;
+	};
+
+	std::map<std::string, Entry> mEntries;
+};
+
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include "ITestRun.h"
+#include "TestTiming.h"
+#include "TestBenchmarkBaseline.h"
+
+namespace UnitTest
+{
+
+// TestBenchmarkRecorder is an ITestRun decorator for benchmark runs.  With compare it
+// compares the samples of every passed benchmark with its samples in a
+// TestBenchmarkBaseline file, fills in the comparison of TestBenchmarkStatistics and fails
+// the benchmark when its median is more than maxRegression (a fraction) slower with at
+// least the given confidence (see TestBenchmarkBaseline::GetConfidence).  The passed and
+// failed counts given to OnTerminate are corrected accordingly.  With save the samples of
+// every passed benchmark that did not regress replace its baseline before OnTerminate is
+// forwarded.
+class TestBenchmarkRecorder : public ITestRun
+{
+public:
+	TestBenchmarkRecorder(ITestRun& testRun, const std::string& fileName, bool save, bool compare, double maxRegression, double confidence)
+		: mTestRun(testRun),
+		mFileName(fileName),
+		mSave(save),
+		mCompare(compare),
+		mMaxRegression(maxRegression),
+		mConfidence(confidence),
+		mClassName(""),
+		mMethodName(""),
+		mRegressedCount(0)
+	{
+		mBaseline.Load(fileName);
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mTestRun.OnInitialize(classCount, totalMethodCount);
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mClassName = className;
+		mTestRun.OnBeginClass(className, methodCount);
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mMethodName = methodName;
+		mTestRun.OnBeginMethod(methodName);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		mTestRun.OnEndMethod(passed, description);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		auto& samples = timing.mBenchmark.mSampleNanoseconds;
+		if (!passed || samples.empty())
+		{
+			mTestRun.OnEndMethod(passed, description, timing);
+			return;
+		}
+		auto baseline = mCompare ? mBaseline.Find(mClassName, mMethodName) : nullptr;
+		if (baseline == nullptr)
+		{
+			Save(samples);
+			mTestRun.OnEndMethod(passed, description, timing);
+			return;
+		}
+
+		auto compared = timing;
+		auto& benchmark = compared.mBenchmark;
+		benchmark.mCompared = true;
+		benchmark.mBaselineMedianNanoseconds = TestBenchmarkBaseline::GetMedian(*baseline);
+		benchmark.mChange = benchmark.mBaselineMedianNanoseconds <= 0 ? 0 :
+			benchmark.mMedianNanoseconds / benchmark.mBaselineMedianNanoseconds - 1;
+		benchmark.mConfidence = TestBenchmarkBaseline::GetConfidence(*baseline, samples, benchmark.mChange >= 0);
+		if (benchmark.mChange > mMaxRegression && benchmark.mConfidence >= mConfidence)
+		{
+			++mRegressedCount;
+			std::ostringstream out;
+			out << std::fixed << std::setprecision(1)
+				<< "Regressed by " << benchmark.mChange * 100 << "% (median " << std::setprecision(3)
+				<< benchmark.mMedianNanoseconds << " ns versus " << benchmark.mBaselineMedianNanoseconds
+				<< " ns, " << std::setprecision(1) << benchmark.mConfidence * 100 << "% confidence, limit "
+				<< mMaxRegression * 100 << "%).";
+			mTestRun.OnEndMethod(false, out.str(), compared);
+		}
+		else
+		{
+			Save(samples);
+			mTestRun.OnEndMethod(passed, description, compared);
+		}
+	}
+	virtual void OnEndClass()
+	{
+		mTestRun.OnEndClass();
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mTestRun.OnMessage(message);
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		if (!mSaved.empty())
+		{
+			for (auto& samples : mSaved)
+				mBaseline.Set(samples.mClassName, samples.mMethodName, samples.mSamples);
+			if (!mBaseline.Save(mFileName))
+				mTestRun.OnMessage("Warning: unable to write benchmark baseline to " + mFileName + ".");
+		}
+		mTestRun.OnTerminate(passedCount - mRegressedCount, failedCount + mRegressedCount);
+	}
+
+private:
+	class Samples
+	{
+	public:
+		Samples(const std::string& className, const std::string& methodName, const std::vector<double>& samples)
+			: mClassName(className), mMethodName(methodName), mSamples(samples)
+		{
+		}
+
+		std::string mClassName;
+		std::string mMethodName;
+		std::vector<double> mSamples;
+	};
+
+	//Only called for benchmarks that did not regress, so a regressed benchmark keeps its
+	//baseline and fails again in the next run.
+	void Save(const std::vector<double>& samples)
+	{
+		if (mSave)
+			mSaved.push_back(Samples(mClassName, mMethodName, samples));
+	}
+
+private:
+	ITestRun& mTestRun;
+	std::string mFileName;
+	bool mSave;
+	bool mCompare;
+	double mMaxRegression;
+	double mConfidence;
+	const char* mClassName;
+	const char* mMethodName;
+	TestBenchmarkBaseline mBaseline;
+	std::vector<Samples> mSaved;
+	unsigned long mRegressedCount;
+};
+
+}
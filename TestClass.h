@@ -33,6 +33,16 @@ public:
 	{
 		//overridable
 	}
+	static unsigned long GetTimeoutMilliseconds()
+	{
+		//overridable (0 uses the run's default timeout)
+		return 0;
+	}
+	static bool ReuseInstance()
+	{
+		//overridable (true keeps one instance per thread for the unit tests of the class)
+		return false;
+	}
 
 	static const char* GetTestClassNameStatic()
 	{
@@ -43,6 +53,10 @@ public:
 		return GetTestClassNameStatic();
 	}
 
+	virtual void Reset()
+	{
+		//overridable (called on a reused instance before BeginTest)
+	}
 	virtual void BeginTest()
 	{
 		//overridable
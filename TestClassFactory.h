@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <new>
 #include "ITestClassFactory.h"
 #include "ITestMethodFactory.h"
 
@@ -41,10 +42,34 @@ public:
 	{
 		return std::shared_ptr<ITestClass>(new T());
 	}
+	virtual std::size_t GetInstanceSize() const
+	{
+		return sizeof(T);
+	}
+	virtual std::size_t GetInstanceAlignment() const
+	{
+		return alignof(T);
+	}
+	virtual ITestClass* ConstructInstance(void* storage) const
+	{
+		return new (storage) T();
+	}
+	virtual void DestroyInstance(ITestClass* instance) const
+	{
+		static_cast<T*>(instance)->~T();
+	}
+	virtual bool IsInstanceReused() const
+	{
+		return T::ReuseInstance();
+	}
 	virtual void TerminateTests()
 	{
 		T::TerminateTests();
 	}
+	virtual unsigned long GetTestClassTimeout() const
+	{
+		return T::GetTimeoutMilliseconds();
+	}
 
 	unsigned long GetCount() const
 	{
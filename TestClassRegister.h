@@ -4,6 +4,13 @@
 namespace UnitTest
 {
 
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+//Test classes are registered along with their test methods (see TestMethodRegister).
+template <typename T>
+class TestClassRegister
+{
+};
+#else
 template <typename T>
 class TestClassRegister
 {
@@ -13,6 +20,7 @@ public:
 		TestRepository::GetInstance().Register<T>();
 	}
 };
+#endif
 
 }
 
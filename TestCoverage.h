@@ -0,0 +1,380 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstdio>
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace UnitTest
+{
+
+// TestCoverage finds the source files executed between Begin and Collect using the
+// gcov runtime of a test executable built with --coverage (GCC, or Clang emitting
+// gcov data).  The runtime is only linked in where UNIT_TEST_COVERAGE() is expanded,
+// which must happen at global scope in exactly one source file of the test executable:
+//
+//	#include "UnitTest.h"
+//	UNIT_TEST_COVERAGE()
+//
+// Collect dumps the
+// counters to the .gcda files (removing the previous ones first so that nothing is
+// merged), reads which functions have a nonzero arc counter and maps them to their
+// source file (including headers) through the .gcno file next to each .gcda file.
+// The .gcda files of this executable are those below the given directory that a first
+// dump on construction writes; other .gcda files are left alone.  The contents of this
+// executable's .gcda files are restored on destruction, so the cumulative coverage of
+// earlier runs is kept (the counters of the unit tests themselves are not added).
+//
+// Example:
+//	TestCoverage coverage(".");
+//	coverage.Begin();
+//	RunTest();
+//	auto files = coverage.Collect();
+class TestCoverage
+{
+public:
+	TestCoverage(const std::string& directory)
+		: mDirectory(directory)
+	{
+		if (!IsAvailable())
+			return;
+		//The files changed by a dump are this executable's; they are set aside since their
+		//coverage data would otherwise be merged into the first Collect.
+		std::map<std::string, Stamp> before;
+		FindDataFiles(mDirectory, before);
+		GetRuntime().mDump();
+		std::map<std::string, Stamp> after;
+		FindDataFiles(mDirectory, after);
+		for (auto& file : after)
+		{
+			auto previous = before.find(file.first);
+			if (previous != before.end() && previous->second == file.second)
+				continue;
+			mDataFiles.push_back(file.first);
+			if (previous != before.end())
+				ReadFile(file.first, mSavedFiles[file.first]);
+		}
+		RemoveDataFiles();
+	}
+
+	~TestCoverage()
+	{
+		RemoveDataFiles();
+		for (auto& saved : mSavedFiles)
+		{
+			std::ofstream out(saved.first.c_str(), std::ios::binary);
+			out.write(saved.second.data(), saved.second.size());
+		}
+	}
+
+	TestCoverage(const TestCoverage& rhs) = delete;
+	TestCoverage& operator=(const TestCoverage& rhs) = delete;
+
+	typedef void (*RuntimeFunction)();
+
+	//Returns true if UNIT_TEST_COVERAGE() is expanded in this executable.
+	static bool IsAvailable()
+	{
+		return GetRuntime().mReset != nullptr && GetRuntime().mDump != nullptr;
+	}
+
+	static bool Install(RuntimeFunction reset, RuntimeFunction dump)
+	{
+		GetRuntime().mReset = reset;
+		GetRuntime().mDump = dump;
+		return true;
+	}
+
+	void Begin()
+	{
+		if (IsAvailable())
+			GetRuntime().mReset();
+	}
+
+	//Returns the source files that executed since Begin.
+	std::set<std::string> Collect()
+	{
+		std::set<std::string> files;
+		if (!IsAvailable())
+			return files;
+		RemoveDataFiles();
+		GetRuntime().mDump();
+		for (auto& dataFile : mDataFiles)
+		{
+			std::unordered_set<std::uint32_t> executed;
+			if (!ReadExecutedFunctions(dataFile, executed) || executed.empty())
+				continue;
+			auto& functions = GetFunctionFiles(dataFile.substr(0, dataFile.size() - 5) + ".gcno");
+			for (auto ident : executed)
+			{
+				auto iter = functions.find(ident);
+				if (iter != functions.end())
+					files.insert(iter->second);
+			}
+		}
+		return files;
+	}
+
+private:
+	static const std::uint32_t DataMagic = 0x67636461;
+	static const std::uint32_t NotesMagic = 0x67636e6f;
+	static const std::uint32_t FunctionTag = 0x01000000;
+	static const std::uint32_t ArcCountersTag = 0x01a10000;
+
+	class Runtime
+	{
+	public:
+		RuntimeFunction mReset;
+		RuntimeFunction mDump;
+	};
+
+	static Runtime& GetRuntime()
+	{
+		static Runtime runtime = { nullptr, nullptr };
+		return runtime;
+	}
+
+	// Reader reads the words and strings of a gcov file.  From GCC 12 on record
+	// lengths and string lengths are in bytes and strings are not padded; before
+	// they are in 4 byte words.
+	class Reader
+	{
+	public:
+		Reader(const std::string& data)
+			: mData(data), mOffset(0), mMajorVersion(0)
+		{
+		}
+
+		bool ReadHeader(std::uint32_t magic)
+		{
+			std::uint32_t value = 0;
+			std::uint32_t version = 0;
+			if (!ReadWord(value) || value != magic || !ReadWord(version) || !ReadWord(value))
+				return false;
+			//The version is e.g. "B22*" for 12.2 and "408*" for 4.8 (most significant byte first).
+			auto first = static_cast<char>(version >> 24);
+			auto second = static_cast<char>(version >> 16);
+			mMajorVersion = first >= 'A' ? (first - 'A') * 10 + (second - '0') : first - '0';
+			return mMajorVersion < 12 || ReadWord(value);
+		}
+
+		bool ReadWord(std::uint32_t& value)
+		{
+			if (mOffset + 4 > mData.size())
+				return false;
+			value = static_cast<unsigned char>(mData[mOffset]) |
+				static_cast<unsigned char>(mData[mOffset + 1]) << 8 |
+				static_cast<unsigned char>(mData[mOffset + 2]) << 16 |
+				static_cast<std::uint32_t>(static_cast<unsigned char>(mData[mOffset + 3])) << 24;
+			mOffset += 4;
+			return true;
+		}
+
+		bool ReadString(std::string& value)
+		{
+			std::uint32_t length = 0;
+			if (!ReadWord(length))
+				return false;
+			std::size_t size = HasByteLengths() ? length : length * 4ul;
+			if (mOffset + size > mData.size())
+				return false;
+			value.assign(mData, mOffset, size);
+			value.resize(value.find('\0') == std::string::npos ? value.size() : value.find('\0'));
+			mOffset += size;
+			return true;
+		}
+
+		//Returns the size in bytes of a record payload with the given length (negative
+		//lengths mark zero counters that are not stored).
+		std::size_t GetPayloadSize(std::uint32_t length) const
+		{
+			if (HasByteLengths())
+				return static_cast<std::int32_t>(length) < 0 ? 0 : length;
+			return length * 4ul;
+		}
+
+		bool HasByteLengths() const
+		{
+			return mMajorVersion >= 12;
+		}
+
+		int GetMajorVersion() const
+		{
+			return mMajorVersion;
+		}
+
+		std::size_t GetOffset() const
+		{
+			return mOffset;
+		}
+
+		void SetOffset(std::size_t offset)
+		{
+			mOffset = offset;
+		}
+
+	private:
+		const std::string& mData;
+		std::size_t mOffset;
+		int mMajorVersion;
+	};
+
+	static bool ReadFile(const std::string& fileName, std::string& data)
+	{
+		std::ifstream in(fileName.c_str(), std::ios::binary);
+		if (!in)
+			return false;
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	static bool ReadExecutedFunctions(const std::string& fileName, std::unordered_set<std::uint32_t>& executed)
+	{
+		std::string data;
+		if (!ReadFile(fileName, data))
+			return false;
+		Reader reader(data);
+		if (!reader.ReadHeader(DataMagic))
+			return false;
+
+		std::uint32_t function = 0;
+		std::uint32_t tag = 0;
+		std::uint32_t length = 0;
+		while (reader.ReadWord(tag) && reader.ReadWord(length))
+		{
+			auto end = reader.GetOffset() + reader.GetPayloadSize(length);
+			if (tag == FunctionTag && reader.GetPayloadSize(length) >= 4)
+				reader.ReadWord(function);
+			else if (tag == ArcCountersTag)
+			{
+				std::uint32_t low = 0;
+				std::uint32_t high = 0;
+				while (reader.GetOffset() + 8 <= end && reader.ReadWord(low) && reader.ReadWord(high))
+					if (low != 0 || high != 0)
+					{
+						executed.insert(function);
+						break;
+					}
+			}
+			reader.SetOffset(end);
+		}
+		return true;
+	}
+
+	//Returns the source file of every function in the notes file (cached per file).
+	const std::unordered_map<std::uint32_t, std::string>& GetFunctionFiles(const std::string& fileName)
+	{
+		auto iter = mFunctionFiles.find(fileName);
+		if (iter != mFunctionFiles.end())
+			return iter->second;
+		auto& functions = mFunctionFiles[fileName];
+
+		std::string data;
+		if (!ReadFile(fileName, data))
+			return functions;
+		Reader reader(data);
+		if (!reader.ReadHeader(NotesMagic))
+			return functions;
+		std::string directory;
+		std::uint32_t value = 0;
+		if (reader.GetMajorVersion() >= 8 && (!reader.ReadString(directory) || !reader.ReadWord(value)))
+			return functions;
+
+		std::uint32_t tag = 0;
+		std::uint32_t length = 0;
+		while (reader.ReadWord(tag) && reader.ReadWord(length))
+		{
+			auto end = reader.GetOffset() + reader.GetPayloadSize(length);
+			std::uint32_t ident = 0;
+			std::string name;
+			std::string file;
+			if (tag == FunctionTag &&
+				reader.ReadWord(ident) &&
+				reader.ReadWord(value) &&
+				reader.ReadWord(value) &&
+				reader.ReadString(name) &&
+				(reader.GetMajorVersion() < 8 || reader.ReadWord(value)) &&
+				reader.ReadString(file))
+				functions[ident] = file.empty() || file[0] == '/' || directory.empty() ? file : directory + "/" + file;
+			reader.SetOffset(end);
+		}
+		return functions;
+	}
+
+	void RemoveDataFiles()
+	{
+		for (auto& dataFile : mDataFiles)
+			std::remove(dataFile.c_str());
+	}
+
+	//Identifies a version of a file: it differs once the file was written.
+	class Stamp
+	{
+	public:
+		bool operator==(const Stamp& rhs) const
+		{
+			return mSeconds == rhs.mSeconds && mNanoseconds == rhs.mNanoseconds && mSize == rhs.mSize;
+		}
+
+		long long mSeconds;
+		long long mNanoseconds;
+		long long mSize;
+	};
+
+	static void FindDataFiles(const std::string& directory, std::map<std::string, Stamp>& files)
+	{
+#if !defined(_WIN32)
+		auto handle = ::opendir(directory.c_str());
+		if (handle == nullptr)
+			return;
+		while (auto entry = ::readdir(handle))
+		{
+			std::string name = entry->d_name;
+			if (name == "." || name == "..")
+				continue;
+			auto path = directory + "/" + name;
+			struct stat status;
+			if (::lstat(path.c_str(), &status) != 0)
+				continue;
+			if (S_ISDIR(status.st_mode))
+				FindDataFiles(path, files);
+			else if (name.size() > 5 && name.compare(name.size() - 5, 5, ".gcda") == 0)
+			{
+				auto& stamp = files[path];
+				stamp.mSeconds = status.st_mtime;
+#if defined(__APPLE__)
+				stamp.mNanoseconds = status.st_mtimespec.tv_nsec;
+#else
+				stamp.mNanoseconds = status.st_mtim.tv_nsec;
+#endif
+				stamp.mSize = status.st_size;
+			}
+		}
+		::closedir(handle);
+#endif
+	}
+
+private:
+	std::string mDirectory;
+	std::vector<std::string> mDataFiles;
+	std::map<std::string, std::string> mSavedFiles;
+	std::map<std::string, std::unordered_map<std::uint32_t, std::string>> mFunctionFiles;
+};
+
+}
+
+//Links the gcov runtime (the test executable must be built with --coverage) so that
+//TestCoverage can reset and dump the coverage counters between unit tests.
+#define UNIT_TEST_COVERAGE() \
+	extern "C" void __gcov_reset(void); \
+	extern "C" void __gcov_dump(void); \
+	static const bool UnitTestCoverageInstalled = UnitTest::TestCoverage::Install(&__gcov_reset, &__gcov_dump);
@@ -0,0 +1,141 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <fstream>
+#include <cstdio>
+#include "ITestClassFactory.h"
+#include "TestPlan.h"
+
+namespace UnitTest
+{
+
+// TestCoverageMap maps each unit test to the source files it executed (see
+// TestCoverage).  The file holds a "ClassName.MethodName" line per unit test (or a
+// "ClassName" line for the files executed by InitializeTests and TerminateTests)
+// followed by one tab-indented line per source file.
+//
+// Example:
+//	TestCoverageMap map;
+//	map.Load(TestCoverageMap::GetDefaultFileName());
+//	map.SelectImpacted(plan, { "src/Parser.cpp" });
+class TestCoverageMap
+{
+public:
+	static const char* GetDefaultFileName()
+	{
+		return "TestCoverage.txt";
+	}
+
+	//Returns false if the file could not be opened (the map is left empty).
+	bool Load(const std::string& fileName)
+	{
+		std::ifstream in(fileName.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		std::set<std::string>* files = nullptr;
+		while (std::getline(in, line))
+			if (line.empty())
+				continue;
+			else if (line[0] != '\t')
+				files = &mFiles[line];
+			else if (files != nullptr)
+				files->insert(line.substr(1));
+		return true;
+	}
+
+	//Writes the map to a temporary file first so that an interrupted run never truncates the file.
+	bool Save(const std::string& fileName) const
+	{
+		auto temporaryName = fileName + ".tmp";
+		{
+			std::ofstream out(temporaryName.c_str());
+			if (!out)
+				return false;
+			for (auto& entry : mFiles)
+			{
+				out << entry.first << '\n';
+				for (auto& file : entry.second)
+					out << '\t' << file << '\n';
+			}
+			if (!out)
+				return false;
+		}
+		std::remove(fileName.c_str());
+		return std::rename(temporaryName.c_str(), fileName.c_str()) == 0;
+	}
+
+	//Replaces the recorded source files of the unit test or test class name.
+	void Set(const std::string& name, const std::set<std::string>& files)
+	{
+		mFiles[name] = files;
+	}
+
+	//Returns the recorded source files of name or nullptr if it was never recorded.
+	const std::set<std::string>* Find(const std::string& name) const
+	{
+		auto iter = mFiles.find(name);
+		return iter == mFiles.end() ? nullptr : &iter->second;
+	}
+
+	//Returns true if the unit test executed, or is defined in, one of the changed files.
+	//Unit tests without recorded coverage are always impacted.
+	bool IsImpacted(const ITestClassFactory& factory, unsigned long methodIndex, const std::vector<std::string>& changedFiles) const
+	{
+		std::string className = factory.GetTestClassName();
+		auto& methodFactory = factory.Get(methodIndex);
+		auto files = Find(className + "." + methodFactory.GetTestMethodName());
+		if (files == nullptr)
+			return true;
+		auto classFiles = Find(className);
+		//The location is "file:line:column".
+		std::string location = methodFactory.GetTestMethodLocation();
+		location = location.substr(0, location.rfind(':', location.rfind(':') - 1));
+		for (auto& changedFile : changedFiles)
+		{
+			if (IsSameFile(location, changedFile) || Contains(*files, changedFile))
+				return true;
+			if (classFiles != nullptr && Contains(*classFiles, changedFile))
+				return true;
+		}
+		return false;
+	}
+
+	//Keeps only the unit tests impacted by the changed files.
+	void SelectImpacted(TestPlan& plan, const std::vector<std::string>& changedFiles) const
+	{
+		plan.Filter([&](const ITestClassFactory& factory, unsigned long methodIndex)
+		{
+			return IsImpacted(factory, methodIndex, changedFiles);
+		});
+	}
+
+	//Returns true if both paths are equal or one is a relative path that the other ends with.
+	static bool IsSameFile(const std::string& left, const std::string& right)
+	{
+		if (left.size() == right.size())
+			return left == right;
+		auto& longer = left.size() > right.size() ? left : right;
+		auto& shorter = left.size() > right.size() ? right : left;
+		if (shorter.empty() || shorter[0] == '/')
+			return false;
+		auto offset = longer.size() - shorter.size();
+		return longer.compare(offset, shorter.size(), shorter) == 0 && (longer[offset - 1] == '/' || longer[offset - 1] == '\\');
+	}
+
+private:
+	static bool Contains(const std::set<std::string>& files, const std::string& changedFile)
+	{
+		for (auto& file : files)
+			if (IsSameFile(file, changedFile))
+				return true;
+		return false;
+	}
+
+private:
+	std::map<std::string, std::set<std::string>> mFiles;
+};
+
+}
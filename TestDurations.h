@@ -0,0 +1,173 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+namespace UnitTest
+{
+
+// TestDurations holds recorded unit test durations (in microseconds) keyed by
+// "ClassName.MethodName".  The file format is one line per unit test containing
+// the class name, the method name and one or more recorded durations (oldest
+// first) separated by whitespace:
+//
+//	FooTest Func 1250 1310 1190
+//
+// The expected duration of a unit test is the mean of its recorded durations.
+class TestDurations
+{
+public:
+	static const char* GetDefaultFileName()
+	{
+		return "TestDurations.txt";
+	}
+
+	static std::string GetKey(const std::string& className, const std::string& methodName)
+	{
+		return className + "." + methodName;
+	}
+
+	//Returns false if the file could not be opened (the durations are left empty).
+	bool Load(const std::string& fileName)
+	{
+		std::ifstream in(fileName.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			std::istringstream fields(line);
+			std::string className;
+			std::string methodName;
+			if (!(fields >> className >> methodName))
+				continue;
+			double value = 0;
+			while (fields >> value)
+				Add(className, methodName, value);
+		}
+		return true;
+	}
+
+	//Writes every unit test with at most the newest window durations.  The file is
+	//written to a temporary file first so that an interrupted run never truncates it.
+	bool Save(const std::string& fileName, unsigned long window) const
+	{
+		std::map<std::string, const Entry*> sorted;
+		for (auto& item : mEntries)
+			sorted[item.first] = &item.second;
+
+		auto temporaryName = fileName + ".tmp";
+		{
+			std::ofstream out(temporaryName.c_str());
+			if (!out)
+				return false;
+			for (auto& item : sorted)
+			{
+				auto& samples = item.second->mSamples;
+				if (samples.empty())
+					continue;
+				out << item.second->mClassName << " " << item.second->mMethodName;
+				auto first = samples.size() > window ? samples.size() - window : 0;
+				for (auto index = first; index < samples.size(); ++index)
+					out << " " << samples[index];
+				out << '\n';
+			}
+			if (!out)
+				return false;
+		}
+		std::remove(fileName.c_str());
+		return std::rename(temporaryName.c_str(), fileName.c_str()) == 0;
+	}
+
+	void Add(const std::string& className, const std::string& methodName, double value)
+	{
+		auto& entry = mEntries[GetKey(className, methodName)];
+		if (entry.mSamples.empty())
+		{
+			entry.mClassName = className;
+			entry.mMethodName = methodName;
+		}
+		entry.mSamples.push_back(value);
+	}
+
+	bool IsEmpty() const
+	{
+		return mEntries.empty();
+	}
+
+	const std::vector<double>* Find(const std::string& key) const
+	{
+		auto iter = mEntries.find(key);
+		return iter == mEntries.end() || iter->second.mSamples.empty() ? nullptr : &iter->second.mSamples;
+	}
+
+	//Returns the mean recorded duration or a negative value if the unit test has no recorded duration.
+	double GetExpected(const std::string& key) const
+	{
+		auto samples = Find(key);
+		return samples == nullptr ? -1 : GetMean(*samples);
+	}
+
+	static double GetMean(const std::vector<double>& samples)
+	{
+		double total = 0;
+		for (auto value : samples)
+			total += value;
+		return samples.empty() ? 0 : total / samples.size();
+	}
+
+	static double GetStandardDeviation(const std::vector<double>& samples)
+	{
+		if (samples.size() < 2)
+			return 0;
+		auto mean = GetMean(samples);
+		double total = 0;
+		for (auto value : samples)
+			total += (value - mean) * (value - mean);
+		return std::sqrt(total / (samples.size() - 1));
+	}
+
+	//Returns the newest window samples.
+	static std::vector<double> GetWindow(const std::vector<double>& samples, unsigned long window)
+	{
+		auto first = samples.size() > window ? samples.end() - window : samples.begin();
+		return std::vector<double>(first, samples.end());
+	}
+
+	//Standard deviation of the history floored at 10% of its mean so that very stable unit
+	//tests do not report noise as a regression.
+	static double GetRegressionDeviation(const std::vector<double>& history)
+	{
+		return std::max(GetStandardDeviation(history), GetMean(history) * 0.1);
+	}
+
+	//Number of regression deviations value lies above the mean of the newest window samples.
+	//Returns 0 when fewer than minimumSamples are recorded.
+	static double GetRegressionScore(const std::vector<double>& samples, double value, unsigned long window, unsigned long minimumSamples)
+	{
+		auto history = GetWindow(samples, window);
+		if (history.size() < minimumSamples || history.empty())
+			return 0;
+		auto deviation = GetRegressionDeviation(history);
+		return deviation <= 0 ? 0 : (value - GetMean(history)) / deviation;
+	}
+
+private:
+	class Entry
+	{
+	public:
+		std::string mClassName;
+		std::string mMethodName;
+		std::vector<double> mSamples;
+	};
+
+	std::unordered_map<std::string, Entry> mEntries;
+};
+
+}
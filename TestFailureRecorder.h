@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include "ITestRun.h"
+#include "TestTiming.h"
+#include "TestFailures.h"
+
+namespace UnitTest
+{
+
+// TestFailureRecorder is an ITestRun decorator that updates a TestFailures file
+// before forwarding OnTerminate: unit tests that failed are added, unit tests that
+// passed are removed and unit tests that did not run (filtered, sharded or skipped
+// by fail-fast) keep their previous state.  A failed InitializeTests or
+// TerminateTests records the test class name.
+class TestFailureRecorder : public ITestRun
+{
+public:
+	TestFailureRecorder(ITestRun& testRun, const std::string& fileName)
+		: mTestRun(testRun), mFileName(fileName), mClassName(""), mMethodName(""), mClassFailed(false)
+	{
+		mFailures.Load(fileName);
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mTestRun.OnInitialize(classCount, totalMethodCount);
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mClassName = className;
+		mClassFailed = false;
+		mTestRun.OnBeginClass(className, methodCount);
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mMethodName = methodName;
+		mTestRun.OnBeginMethod(methodName);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		mTestRun.OnEndMethod(passed, description);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		if (mMethodName[0] == '[')
+			mClassFailed = mClassFailed || !passed;
+		else if (passed)
+			mFailures.Remove(std::string(mClassName) + "." + mMethodName);
+		else
+			mFailures.Add(std::string(mClassName) + "." + mMethodName);
+		mTestRun.OnEndMethod(passed, description, timing);
+	}
+	virtual void OnEndClass()
+	{
+		if (mClassFailed)
+			mFailures.Add(mClassName);
+		else
+			mFailures.Remove(mClassName);
+		mTestRun.OnEndClass();
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mTestRun.OnMessage(message);
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		if (!mFailures.Save(mFileName))
+			mTestRun.OnMessage("Warning: unable to write test failures to " + mFileName + ".");
+		mTestRun.OnTerminate(passedCount, failedCount);
+	}
+
+private:
+	ITestRun& mTestRun;
+	std::string mFileName;
+	TestFailures mFailures;
+	const char* mClassName;
+	const char* mMethodName;
+	bool mClassFailed;
+};
+
+}
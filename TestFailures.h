@@ -0,0 +1,100 @@
+#pragma once
+#include <string>
+#include <set>
+#include <fstream>
+#include <cstdio>
+#include "ITestClassFactory.h"
+#include "TestPlan.h"
+
+namespace UnitTest
+{
+
+// TestFailures is the set of unit tests that failed in the previous run, stored one
+// name per line.  A "ClassName.MethodName" line is a failed unit test and a line
+// without a '.' is a test class whose InitializeTests or TerminateTests failed.
+//
+// Example:
+//	TestFailures failures;
+//	failures.Load(TestFailures::GetDefaultFileName());
+//	failures.Prioritize(plan);
+class TestFailures
+{
+public:
+	static const char* GetDefaultFileName()
+	{
+		return "TestFailures.txt";
+	}
+
+	//Returns false if the file could not be opened (the set is left empty).
+	bool Load(const std::string& fileName)
+	{
+		std::ifstream in(fileName.c_str());
+		if (!in)
+			return false;
+		std::string line;
+		while (std::getline(in, line))
+			if (!line.empty())
+				mNames.insert(line);
+		return true;
+	}
+
+	//Writes the names to a temporary file first so that an interrupted run never truncates the file.
+	bool Save(const std::string& fileName) const
+	{
+		auto temporaryName = fileName + ".tmp";
+		{
+			std::ofstream out(temporaryName.c_str());
+			if (!out)
+				return false;
+			for (auto& name : mNames)
+				out << name << '\n';
+			if (!out)
+				return false;
+		}
+		std::remove(fileName.c_str());
+		return std::rename(temporaryName.c_str(), fileName.c_str()) == 0;
+	}
+
+	void Add(const std::string& name)
+	{
+		mNames.insert(name);
+	}
+
+	void Remove(const std::string& name)
+	{
+		mNames.erase(name);
+	}
+
+	bool Contains(const std::string& name) const
+	{
+		return mNames.find(name) != mNames.end();
+	}
+
+	bool IsEmpty() const
+	{
+		return mNames.empty();
+	}
+
+	//Returns true if the unit test or its test class failed.
+	bool HasFailed(const ITestClassFactory& factory, unsigned long methodIndex) const
+	{
+		std::string className = factory.GetTestClassName();
+		return Contains(className) || Contains(className + "." + factory.Get(methodIndex).GetTestMethodName());
+	}
+
+	//Moves the failed unit tests, and the test classes containing them, to the front of the plan.
+	void Prioritize(TestPlan& plan) const
+	{
+		if (IsEmpty())
+			return;
+		plan.Prioritize([this](const ITestClassFactory& factory, unsigned long methodIndex)
+		{
+			return HasFailed(factory, methodIndex);
+		});
+	}
+
+private:
+	std::set<std::string> mNames;
+};
+
+}
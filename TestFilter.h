@@ -0,0 +1,196 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <regex>
+#include <algorithm>
+#include "TestIndex.h"
+#include "TestPlan.h"
+
+namespace UnitTest
+{
+
+// TestFilter selects unit tests by their "ClassName.MethodName" name.  A pattern
+// starting with "re:" is an ECMAScript regular expression that must match the whole
+// name, otherwise it is a glob where '*' matches any sequence and '?' any single
+// character.  A glob without wildcards matches the named unit test or, if it has no
+// '.', every unit test of the named test class; those are resolved through the
+// TestIndex without visiting any other unit test.
+//
+// A unit test is selected when it matches at least one include pattern (or there
+// are no include patterns) and does not match any exclude pattern.
+//
+// Example:
+//	TestFilter filter;
+//	filter.Include("FooTest.*");
+//	filter.Include("re:Bar.*Test\\.Func[0-9]+");
+//	filter.Exclude("*Slow*");
+//	auto plan = filter.CreatePlan(TestIndex::GetInstance());
+class TestFilter
+{
+public:
+	void Include(const std::string& pattern)
+	{
+		mIncludes.push_back(Pattern(pattern));
+	}
+
+	void Exclude(const std::string& pattern)
+	{
+		mExcludes.push_back(Pattern(pattern));
+	}
+
+	//Returns false, with the reason in error, if pattern is a regular expression that
+	//does not compile (Include and Exclude throw std::regex_error for it).
+	static bool IsValid(const std::string& pattern, std::string& error)
+	{
+		try
+		{
+			Pattern checked(pattern);
+			return true;
+		}
+		catch (const std::regex_error& exception)
+		{
+			error = exception.what();
+			return false;
+		}
+	}
+
+	bool IsEmpty() const
+	{
+		return mIncludes.empty() && mExcludes.empty();
+	}
+
+	bool IsSelected(const std::string& name) const
+	{
+		return (mIncludes.empty() || Matches(mIncludes, name)) && !Matches(mExcludes, name);
+	}
+
+	TestPlan CreatePlan(const TestIndex& index) const
+	{
+		auto& entries = index.GetEntries();
+		std::vector<unsigned long> selected;
+		if (HasOnlyExactIncludes())
+		{
+			for (auto& include : mIncludes)
+				AddExact(index, include.mText, selected);
+			std::sort(selected.begin(), selected.end());
+			selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+			selected.erase(std::remove_if(selected.begin(), selected.end(), [&](unsigned long position)
+			{
+				return Matches(mExcludes, entries[position].mName);
+			}), selected.end());
+		}
+		else
+			for (auto position = 0ul; position < entries.size(); ++position)
+				if (IsSelected(entries[position].mName))
+					selected.push_back(position);
+
+		TestPlan plan;
+		TestPlanClass* current = nullptr;
+		for (auto position : selected)
+		{
+			auto& entry = entries[position];
+			if (current == nullptr || current->mFactory != entry.mFactory)
+				current = &plan.Add(*entry.mFactory);
+			current->mMethods.push_back(entry.mMethodIndex);
+		}
+		return plan;
+	}
+
+	static bool IsGlobMatch(const char* pattern, const char* text)
+	{
+		const char* starPattern = nullptr;
+		const char* starText = nullptr;
+		while (*text != '\0')
+		{
+			if (*pattern == '*')
+			{
+				starPattern = ++pattern;
+				starText = text;
+			}
+			else if (*pattern == '?' || *pattern == *text)
+			{
+				++pattern;
+				++text;
+			}
+			else if (starPattern != nullptr)
+			{
+				pattern = starPattern;
+				text = ++starText;
+			}
+			else
+				return false;
+		}
+		while (*pattern == '*')
+			++pattern;
+		return *pattern == '\0';
+	}
+
+private:
+	class Pattern
+	{
+	public:
+		Pattern(const std::string& text)
+			: mText(text), mIsRegex(text.compare(0, 3, "re:") == 0)
+		{
+			if (mIsRegex)
+				mRegex = std::regex(text.substr(3));
+		}
+
+		bool IsExact() const
+		{
+			return !mIsRegex && mText.find_first_of("*?") == std::string::npos;
+		}
+
+		bool Matches(const std::string& name) const
+		{
+			if (mIsRegex)
+				return std::regex_match(name, mRegex);
+			if (IsExact() && mText.find('.') == std::string::npos)
+				return name.size() > mText.size() && name.compare(0, mText.size(), mText) == 0 && name[mText.size()] == '.';
+			return IsGlobMatch(mText.c_str(), name.c_str());
+		}
+
+		std::string mText;
+		bool mIsRegex;
+		std::regex mRegex;
+	};
+
+	static bool Matches(const std::vector<Pattern>& patterns, const std::string& name)
+	{
+		for (auto& pattern : patterns)
+			if (pattern.Matches(name))
+				return true;
+		return false;
+	}
+
+	bool HasOnlyExactIncludes() const
+	{
+		if (mIncludes.empty())
+			return false;
+		for (auto& include : mIncludes)
+			if (!include.IsExact())
+				return false;
+		return true;
+	}
+
+	static void AddExact(const TestIndex& index, const std::string& name, std::vector<unsigned long>& selected)
+	{
+		auto entry = index.FindMethod(name);
+		if (entry != nullptr)
+		{
+			selected.push_back(entry - index.GetEntries().data());
+			return;
+		}
+		unsigned long first = 0;
+		unsigned long last = 0;
+		index.GetClassRange(name, first, last);
+		for (auto position = first; position < last; ++position)
+			selected.push_back(position);
+	}
+
+private:
+	std::vector<Pattern> mIncludes;
+	std::vector<Pattern> mExcludes;
+};
+
+}
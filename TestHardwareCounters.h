@@ -0,0 +1,238 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace UnitTest
+{
+
+// TestHardwareCounts holds the hardware events counted while a unit test method (or the
+// timed samples of a benchmark) ran on its thread, in user mode.  mMeasured is false when
+// counting was off or unavailable; an event the CPU does not support stays 0.
+class TestHardwareCounts
+{
+public:
+	TestHardwareCounts()
+		: mMeasured(false),
+		mCycles(0),
+		mInstructions(0),
+		mCacheReferences(0),
+		mCacheMisses(0),
+		mBranches(0),
+		mBranchMisses(0)
+	{
+	}
+
+	TestHardwareCounts& operator+=(const TestHardwareCounts& rhs)
+	{
+		mMeasured = mMeasured || rhs.mMeasured;
+		mCycles += rhs.mCycles;
+		mInstructions += rhs.mInstructions;
+		mCacheReferences += rhs.mCacheReferences;
+		mCacheMisses += rhs.mCacheMisses;
+		mBranches += rhs.mBranches;
+		mBranchMisses += rhs.mBranchMisses;
+		return *this;
+	}
+
+	double GetInstructionsPerCycle() const
+	{
+		return mCycles == 0 ? 0 : static_cast<double>(mInstructions) / mCycles;
+	}
+
+	//Fraction of the cache references (last level cache accesses) that missed.
+	double GetCacheMissRate() const
+	{
+		return mCacheReferences == 0 ? 0 : static_cast<double>(mCacheMisses) / mCacheReferences;
+	}
+
+	//Fraction of the branch instructions that were mispredicted.
+	double GetBranchMissRate() const
+	{
+		return mBranches == 0 ? 0 : static_cast<double>(mBranchMisses) / mBranches;
+	}
+
+	bool mMeasured;
+	unsigned long long mCycles;
+	unsigned long long mInstructions;
+	unsigned long long mCacheReferences;
+	unsigned long long mCacheMisses;
+	unsigned long long mBranches;
+	unsigned long long mBranchMisses;
+};
+
+// TestHardwareCounters counts hardware events of the calling thread with Linux
+// perf_event_open.  Every thread opens one group of counters on first use and keeps it
+// open; Start and Stop read the group, so counting costs two system calls per measured
+// interval.  When the PMU has to multiplex the counters the counts are scaled by the time
+// they were actually counting.  Counting needs a kernel.perf_event_paranoid setting of 2
+// or less (or CAP_PERFMON) and is commonly unavailable in containers and virtual machines;
+// IsAvailable reports why.  Elsewhere nothing is counted.
+//
+// Example:
+//	TestHardwareCounts counts;
+//	TestHardwareCounters::Start();
+//	method->Execute();
+//	TestHardwareCounters::Stop(counts);
+class TestHardwareCounters
+{
+public:
+	//Returns false, with the reason in error, if the counters cannot be opened on the calling thread.
+	static bool IsAvailable(std::string& error)
+	{
+#if defined(__linux__)
+		return GetGroup().Open(error);
+#else
+		error = "hardware performance counters are only supported on Linux";
+		return false;
+#endif
+	}
+
+	static void Start()
+	{
+#if defined(__linux__)
+		auto& group = GetGroup();
+		std::string error;
+		group.mStarted = group.Open(error) && group.Read(group.mStart);
+#endif
+	}
+
+	//Adds the events counted on the calling thread since Start to counts.
+	static void Stop(TestHardwareCounts& counts)
+	{
+#if defined(__linux__)
+		auto& group = GetGroup();
+		Reading end;
+		if (!group.mStarted || !group.Read(end))
+			return;
+		group.mStarted = false;
+		//Scales the counts when the group was only counting part of the time it was enabled.
+		auto enabled = end.mTimeEnabled - group.mStart.mTimeEnabled;
+		auto running = end.mTimeRunning - group.mStart.mTimeRunning;
+		auto scale = running == 0 || running >= enabled ? 1.0 : static_cast<double>(enabled) / running;
+		counts.mMeasured = true;
+		for (auto index = 0ul; index < group.mCount; ++index)
+		{
+			auto count = static_cast<unsigned long long>((end.mValues[index] - group.mStart.mValues[index]) * scale);
+			switch (group.mEvents[index])
+			{
+			case PERF_COUNT_HW_CPU_CYCLES: counts.mCycles += count; break;
+			case PERF_COUNT_HW_INSTRUCTIONS: counts.mInstructions += count; break;
+			case PERF_COUNT_HW_CACHE_REFERENCES: counts.mCacheReferences += count; break;
+			case PERF_COUNT_HW_CACHE_MISSES: counts.mCacheMisses += count; break;
+			case PERF_COUNT_HW_BRANCH_INSTRUCTIONS: counts.mBranches += count; break;
+			case PERF_COUNT_HW_BRANCH_MISSES: counts.mBranchMisses += count; break;
+			}
+		}
+#else
+		(void)counts;
+#endif
+	}
+
+#if defined(__linux__)
+private:
+	static const unsigned long MaxEvents = 6;
+
+	//Layout read from the group leader with PERF_FORMAT_GROUP.
+	class Reading
+	{
+	public:
+		std::uint64_t mCount;
+		std::uint64_t mTimeEnabled;
+		std::uint64_t mTimeRunning;
+		std::uint64_t mValues[MaxEvents];
+	};
+
+	class Group
+	{
+	public:
+		Group()
+			: mProcess(0), mCount(0), mStarted(false)
+		{
+		}
+
+		~Group()
+		{
+			Close();
+		}
+
+		//Opens the group unless it is open in this process (a forked child must reopen it).
+		bool Open(std::string& error)
+		{
+			if (mCount != 0 && mProcess == ::getpid())
+				return true;
+			Close();
+			static const std::uint64_t events[MaxEvents] = {
+				PERF_COUNT_HW_CPU_CYCLES,
+				PERF_COUNT_HW_INSTRUCTIONS,
+				PERF_COUNT_HW_CACHE_REFERENCES,
+				PERF_COUNT_HW_CACHE_MISSES,
+				PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+				PERF_COUNT_HW_BRANCH_MISSES };
+			for (auto event : events)
+			{
+				perf_event_attr attributes;
+				std::memset(&attributes, 0, sizeof(attributes));
+				attributes.size = sizeof(attributes);
+				attributes.type = PERF_TYPE_HARDWARE;
+				attributes.config = event;
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				auto descriptor = static_cast<int>(::syscall(__NR_perf_event_open, &attributes, 0, -1, mCount == 0 ? -1 : mDescriptors[0], 0));
+				if (descriptor >= 0)
+				{
+					mDescriptors[mCount] = descriptor;
+					mEvents[mCount++] = event;
+				}
+				else if (mCount == 0)
+				{
+					//Without the cycles leader there is nothing worth counting.
+					auto code = errno;
+					error = std::string("perf_event_open failed: ") + std::strerror(code);
+					if (code == EACCES || code == EPERM)
+						error += " (see /proc/sys/kernel/perf_event_paranoid)";
+					return false;
+				}
+			}
+			mProcess = ::getpid();
+			return true;
+		}
+
+		void Close()
+		{
+			for (auto index = mCount; index > 0; --index)
+				::close(mDescriptors[index - 1]);
+			mCount = 0;
+			mStarted = false;
+		}
+
+		bool Read(Reading& reading)
+		{
+			auto size = static_cast<ssize_t>(sizeof(std::uint64_t) * (3 + mCount));
+			return mCount != 0 && ::read(mDescriptors[0], &reading, size) == size && reading.mCount == mCount;
+		}
+
+		pid_t mProcess;
+		unsigned long mCount;
+		int mDescriptors[MaxEvents];
+		std::uint64_t mEvents[MaxEvents];
+		bool mStarted;
+		Reading mStart;
+	};
+
+	static Group& GetGroup()
+	{
+		static thread_local Group group;
+		return group;
+	}
+#endif
+};
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include "ITestRun.h"
+#include "TestTiming.h"
+#include "TestDurations.h"
+
+namespace UnitTest
+{
+
+// TestHistoryRecorder is an ITestRun decorator that appends the duration of every
+// passed unit test to a TestDurations file and, before forwarding OnTerminate,
+// reports each unit test whose duration regressed beyond the threshold (see
+// TestDurations::GetRegressionScore) versus its recorded history via OnMessage.
+class TestHistoryRecorder : public ITestRun
+{
+public:
+	TestHistoryRecorder(ITestRun& testRun, const std::string& fileName, unsigned long window, double threshold)
+		: mTestRun(testRun), mFileName(fileName), mWindow(window), mThreshold(threshold), mClassName(""), mMethodName("")
+	{
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mTestRun.OnInitialize(classCount, totalMethodCount);
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mClassName = className;
+		mTestRun.OnBeginClass(className, methodCount);
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mMethodName = methodName;
+		mTestRun.OnBeginMethod(methodName);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		mTestRun.OnEndMethod(passed, description);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		if (passed && mMethodName[0] != '[')
+			mDurations.push_back(Duration(mClassName, mMethodName, timing.GetTotal().mWallNanoseconds / 1000.0));
+		mTestRun.OnEndMethod(passed, description, timing);
+	}
+	virtual void OnEndClass()
+	{
+		mTestRun.OnEndClass();
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mTestRun.OnMessage(message);
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		TestDurations history;
+		history.Load(mFileName);
+		for (auto& duration : mDurations)
+		{
+			auto samples = history.Find(TestDurations::GetKey(duration.mClassName, duration.mMethodName));
+			if (samples != nullptr)
+				CheckRegression(duration, *samples);
+		}
+
+		for (auto& duration : mDurations)
+			history.Add(duration.mClassName, duration.mMethodName, duration.mMicroseconds);
+		if (!mDurations.empty() && !history.Save(mFileName, mWindow))
+			mTestRun.OnMessage("Warning: unable to write test duration history to " + mFileName + ".");
+
+		mTestRun.OnTerminate(passedCount, failedCount);
+	}
+
+	//Minimum number of recorded durations before a unit test can be reported as regressed.
+	static unsigned long GetMinimumSamples()
+	{
+		return 5;
+	}
+
+private:
+	class Duration
+	{
+	public:
+		Duration(const std::string& className, const std::string& methodName, double microseconds)
+			: mClassName(className), mMethodName(methodName), mMicroseconds(microseconds)
+		{
+		}
+
+		std::string mClassName;
+		std::string mMethodName;
+		double mMicroseconds;
+	};
+
+	void CheckRegression(const Duration& duration, const std::vector<double>& samples)
+	{
+		auto score = TestDurations::GetRegressionScore(samples, duration.mMicroseconds, mWindow, GetMinimumSamples());
+		if (score <= mThreshold)
+			return;
+		//Reports the mean and deviation the score was computed from.
+		auto history = TestDurations::GetWindow(samples, mWindow);
+		std::ostringstream out;
+		out << std::fixed << std::setprecision(1)
+			<< "Warning: " << duration.mClassName << "." << duration.mMethodName << " took "
+			<< duration.mMicroseconds << " us versus a mean of " << TestDurations::GetMean(history)
+			<< " us over the last " << history.size() << " run(s) (" << score << " standard deviations of "
+			<< TestDurations::GetRegressionDeviation(history) << " us slower).";
+		mTestRun.OnMessage(out.str());
+	}
+
+private:
+	ITestRun& mTestRun;
+	std::string mFileName;
+	unsigned long mWindow;
+	double mThreshold;
+	const char* mClassName;
+	const char* mMethodName;
+	std::vector<Duration> mDurations;
+};
+
+}
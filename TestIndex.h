@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ITestClassFactory.h"
+#include "TestRepository.h"
+
+namespace UnitTest
+{
+
+// TestIndexEntry identifies one registered unit test by its test class factory, the
+// position of that factory in the TestRepository and the method index in the factory.
+class TestIndexEntry
+{
+public:
+	TestIndexEntry(ITestClassFactory& factory, unsigned long classIndex, unsigned long methodIndex, const std::string& name)
+		: mFactory(&factory), mClassIndex(classIndex), mMethodIndex(methodIndex), mName(name)
+	{
+	}
+
+	ITestClassFactory* mFactory;
+	unsigned long mClassIndex;
+	unsigned long mMethodIndex;
+	//"ClassName.MethodName"
+	std::string mName;
+};
+
+// TestIndex is a name index over the TestRepository built once so that unit tests
+// and test classes can be found by name without scanning every registration.
+// The entries are stored in registration order and the entries of one test class
+// are contiguous.
+//
+// Example:
+//	auto& index = TestIndex::GetInstance();
+//	auto entry = index.FindMethod("FooTest.Func");
+class TestIndex
+{
+public:
+	//Returns the index of the current TestRepository contents (rebuilt when registrations change).
+	static const TestIndex& GetInstance()
+	{
+		static TestIndex instance;
+		auto& repository = TestRepository::GetInstance();
+		if (instance.mGeneration != repository.GetGeneration())
+			instance.Build(repository);
+		return instance;
+	}
+
+	const std::vector<TestIndexEntry>& GetEntries() const
+	{
+		return mEntries;
+	}
+
+	const TestIndexEntry* FindMethod(const std::string& name) const
+	{
+		auto iter = mMethods.find(name);
+		return iter == mMethods.end() ? nullptr : &mEntries[iter->second];
+	}
+
+	const TestIndexEntry* FindMethod(const std::string& className, const std::string& methodName) const
+	{
+		return FindMethod(className + "." + methodName);
+	}
+
+	ITestClassFactory* FindClass(const std::string& name) const
+	{
+		auto iter = mClasses.find(name);
+		return iter == mClasses.end() ? nullptr : mClassRanges[iter->second].mFactory;
+	}
+
+	//Returns the positions in GetEntries() of the first unit test of the named class and
+	//one past its last unit test (both zero if the class is not registered).
+	void GetClassRange(const std::string& name, unsigned long& first, unsigned long& last) const
+	{
+		auto iter = mClasses.find(name);
+		first = iter == mClasses.end() ? 0 : mClassRanges[iter->second].mFirst;
+		last = iter == mClasses.end() ? 0 : mClassRanges[iter->second].mLast;
+	}
+
+private:
+	class ClassRange
+	{
+	public:
+		ITestClassFactory* mFactory;
+		unsigned long mFirst;
+		unsigned long mLast;
+	};
+
+	TestIndex()
+		: mGeneration(0)
+	{
+	}
+
+	void Build(const TestRepository& repository)
+	{
+		mEntries.clear();
+		mMethods.clear();
+		mClasses.clear();
+		mClassRanges.clear();
+		for (auto classIndex = 0ul; classIndex < repository.GetCount(); ++classIndex)
+		{
+			auto& factory = repository.Get(classIndex);
+			std::string className = factory.GetTestClassName();
+			ClassRange range = { &factory, mEntries.size(), 0 };
+			for (auto methodIndex = 0ul; methodIndex < factory.GetCount(); ++methodIndex)
+			{
+				mEntries.push_back(TestIndexEntry(factory, classIndex, methodIndex,
+					className + "." + factory.Get(methodIndex).GetTestMethodName()));
+				mMethods.insert(std::make_pair(mEntries.back().mName, mEntries.size() - 1));
+			}
+			range.mLast = mEntries.size();
+			mClasses.insert(std::make_pair(className, mClassRanges.size()));
+			mClassRanges.push_back(range);
+		}
+		mGeneration = repository.GetGeneration();
+	}
+
+private:
+	unsigned long mGeneration;
+	std::vector<TestIndexEntry> mEntries;
+	std::unordered_map<std::string, unsigned long> mMethods;
+	std::unordered_map<std::string, unsigned long> mClasses;
+	std::vector<ClassRange> mClassRanges;
+};
+
+}
@@ -0,0 +1,339 @@
+#pragma once
+#if !defined(_WIN32)
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <exception>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ITestClassFactory.h"
+#include "TestRepository.h"
+
+namespace UnitTest
+{
+
+// ResidentTestClassFactory keeps a test class initialized across test runs: the first
+// InitializeTests call initializes the wrapped test class and later calls do nothing
+// (until one succeeds), TerminateTests does nothing and Terminate really terminates
+// the test class.  Everything else is forwarded to the wrapped factory.
+class ResidentTestClassFactory : public ITestClassFactory
+{
+public:
+	ResidentTestClassFactory(ITestClassFactory& factory)
+		: mFactory(factory), mInitialized(false)
+	{
+	}
+
+	virtual const char* GetTestClassName() const
+	{
+		return mFactory.GetTestClassName();
+	}
+	virtual void InitializeTests()
+	{
+		if (mInitialized)
+			return;
+		mFactory.InitializeTests();
+		mInitialized = true;
+	}
+	virtual std::shared_ptr<ITestClass> CreateInstance() const
+	{
+		return mFactory.CreateInstance();
+	}
+	virtual std::size_t GetInstanceSize() const
+	{
+		return mFactory.GetInstanceSize();
+	}
+	virtual std::size_t GetInstanceAlignment() const
+	{
+		return mFactory.GetInstanceAlignment();
+	}
+	virtual ITestClass* ConstructInstance(void* storage) const
+	{
+		return mFactory.ConstructInstance(storage);
+	}
+	virtual void DestroyInstance(ITestClass* instance) const
+	{
+		mFactory.DestroyInstance(instance);
+	}
+	virtual bool IsInstanceReused() const
+	{
+		return mFactory.IsInstanceReused();
+	}
+	virtual void TerminateTests()
+	{
+	}
+	virtual unsigned long GetTestClassTimeout() const
+	{
+		return mFactory.GetTestClassTimeout();
+	}
+	virtual unsigned long GetCount() const
+	{
+		return mFactory.GetCount();
+	}
+	virtual ITestMethodFactory& Get(unsigned long index) const
+	{
+		return mFactory.Get(index);
+	}
+
+	ITestClassFactory& GetFactory() const
+	{
+		return mFactory;
+	}
+
+	//Calls the wrapped TerminateTests if the test class was initialized; failures are ignored.
+	void Terminate()
+	{
+		if (!mInitialized)
+			return;
+		mInitialized = false;
+		try
+		{
+			mFactory.TerminateTests();
+		}
+		catch (...)
+		{
+		}
+	}
+
+private:
+	ITestClassFactory& mFactory;
+	bool mInitialized;
+};
+
+// TestLibraryHost loads test classes compiled into shared libraries, so that a resident
+// runner can rerun them after rebuilding a library without restarting.  Test classes
+// register into the TestRepository of the host while the library is opened, which
+// requires the host executable to export its symbols (link it with -rdynamic).  Every
+// test class, including those of the host executable, is wrapped in a
+// ResidentTestClassFactory so that InitializeTests runs only once per loaded library.
+//
+// A library is opened from a private copy so that it can be rebuilt while loaded.  It
+// can only be unloaded if it does not define STB_GNU_UNIQUE symbols, which GCC emits for
+// static locals of inline functions (such as the test class factories); compile test
+// libraries with -fno-gnu-unique.
+//
+// Example:
+//	TestLibraryHost host;
+//	host.Load("libFooTests.so", error);
+//	TestRunner::RunTests(writer);
+//	host.ReloadChanged(reloaded, error);
+class TestLibraryHost
+{
+public:
+	TestLibraryHost()
+		: mNextCopy(0)
+	{
+		Adopt(mHostFactories, 0);
+	}
+
+	~TestLibraryHost()
+	{
+		std::string error;
+		while (!mLibraries.empty())
+			Unload(mLibraries.back()->mFileName, error);
+		Release(mHostFactories, true);
+	}
+
+	TestLibraryHost(const TestLibraryHost& rhs) = delete;
+	TestLibraryHost& operator=(const TestLibraryHost& rhs) = delete;
+
+	bool Load(const std::string& fileName, std::string& error)
+	{
+		std::unique_ptr<Library> library(new Library());
+		library->mFileName = fileName;
+		if (!GetVersion(fileName, library->mVersion))
+		{
+			error = "unable to find " + fileName + ".";
+			return false;
+		}
+		std::string copyName;
+		if (!Copy(fileName, copyName))
+		{
+			error = "unable to copy " + fileName + ".";
+			return false;
+		}
+
+		auto& repository = TestRepository::GetInstance();
+		auto first = repository.GetCount();
+		library->mHandle = ::dlopen(copyName.c_str(), RTLD_NOW | RTLD_LOCAL);
+		std::remove(copyName.c_str());
+		if (library->mHandle == nullptr)
+		{
+			auto message = ::dlerror();
+			error = "unable to load " + fileName + ": " + (message != nullptr ? message : "unknown error") + ".";
+			return false;
+		}
+		library->mCopyName = copyName;
+		if (repository.GetCount() == first)
+		{
+			::dlclose(library->mHandle);
+			error = fileName + " registered no test classes in this executable (is it linked with -rdynamic?).";
+			return false;
+		}
+		Adopt(library->mFactories, first);
+		mLibraries.push_back(std::move(library));
+		return true;
+	}
+
+	//Terminates the initialized test classes of the library and unloads it.
+	bool Unload(const std::string& fileName, std::string& error)
+	{
+		auto iter = Find(fileName);
+		if (iter == mLibraries.end())
+		{
+			error = fileName + " is not loaded.";
+			return false;
+		}
+		std::unique_ptr<Library> library(std::move(*iter));
+		mLibraries.erase(iter);
+		Release(library->mFactories, false);
+		::dlclose(library->mHandle);
+
+		auto handle = ::dlopen(library->mCopyName.c_str(), RTLD_NOW | RTLD_NOLOAD);
+		if (handle != nullptr)
+		{
+			::dlclose(handle);
+			error = fileName + " could not be unloaded (compile it with -fno-gnu-unique).";
+			return false;
+		}
+		return true;
+	}
+
+	//Reloads the libraries whose file changed since they were loaded and adds their names to reloaded.
+	bool ReloadChanged(std::vector<std::string>& reloaded, std::string& error)
+	{
+		std::vector<std::string> changed;
+		for (auto& library : mLibraries)
+		{
+			Version version;
+			if (GetVersion(library->mFileName, version) && !(version == library->mVersion))
+				changed.push_back(library->mFileName);
+		}
+		auto succeeded = true;
+		for (auto& fileName : changed)
+		{
+			if (Unload(fileName, error) && Load(fileName, error))
+				reloaded.push_back(fileName);
+			else
+				succeeded = false;
+		}
+		return succeeded;
+	}
+
+private:
+	class Version
+	{
+	public:
+		bool operator==(const Version& rhs) const
+		{
+			return mModified == rhs.mModified && mModifiedNanoseconds == rhs.mModifiedNanoseconds &&
+				mSize == rhs.mSize && mInode == rhs.mInode;
+		}
+
+		long long mModified;
+		long long mModifiedNanoseconds;
+		long long mSize;
+		unsigned long long mInode;
+	};
+
+	class Library
+	{
+	public:
+		Library()
+			: mHandle(nullptr)
+		{
+		}
+
+		std::string mFileName;
+		std::string mCopyName;
+		void* mHandle;
+		Version mVersion;
+		std::vector<std::unique_ptr<ResidentTestClassFactory>> mFactories;
+	};
+
+	typedef std::vector<std::unique_ptr<Library>>::iterator LibraryIterator;
+
+	LibraryIterator Find(const std::string& fileName)
+	{
+		for (auto iter = mLibraries.begin(); iter != mLibraries.end(); ++iter)
+			if ((*iter)->mFileName == fileName)
+				return iter;
+		return mLibraries.end();
+	}
+
+	//Wraps the registrations from first on in ResidentTestClassFactory instances owned by factories.
+	static void Adopt(std::vector<std::unique_ptr<ResidentTestClassFactory>>& factories, unsigned long first)
+	{
+		auto& repository = TestRepository::GetInstance();
+		for (auto index = first; index < repository.GetCount(); ++index)
+		{
+			if (dynamic_cast<ResidentTestClassFactory*>(&repository.Get(index)) != nullptr)
+				continue;
+			factories.push_back(std::unique_ptr<ResidentTestClassFactory>(new ResidentTestClassFactory(repository.Get(index))));
+			repository.Replace(index, *factories.back());
+		}
+	}
+
+	//Terminates the test classes and removes their registrations (or restores the wrapped ones).
+	static void Release(std::vector<std::unique_ptr<ResidentTestClassFactory>>& factories, bool restore)
+	{
+		auto& repository = TestRepository::GetInstance();
+		for (auto iter = factories.rbegin(); iter != factories.rend(); ++iter)
+		{
+			auto& factory = **iter;
+			factory.Terminate();
+			for (auto index = 0ul; index < repository.GetCount(); ++index)
+				if (&repository.Get(index) == &factory && restore)
+					repository.Replace(index, factory.GetFactory());
+			if (!restore)
+				repository.Remove(factory);
+		}
+		factories.clear();
+	}
+
+	static bool GetVersion(const std::string& fileName, Version& version)
+	{
+		struct stat status;
+		if (::stat(fileName.c_str(), &status) != 0)
+			return false;
+		version.mModified = status.st_mtime;
+#if defined(__linux__)
+		version.mModifiedNanoseconds = status.st_mtim.tv_nsec;
+#else
+		version.mModifiedNanoseconds = 0;
+#endif
+		version.mSize = status.st_size;
+		version.mInode = status.st_ino;
+		return true;
+	}
+
+	//Copies the library to a new temporary file; the dynamic loader would return the
+	//already loaded library for a file name it has seen.
+	bool Copy(const std::string& fileName, std::string& copyName)
+	{
+		auto directory = std::getenv("TMPDIR");
+		copyName = std::string(directory != nullptr ? directory : "/tmp") + "/UnitTestLibrary." +
+			std::to_string(::getpid()) + "." + std::to_string(++mNextCopy) + ".so";
+		std::ifstream in(fileName.c_str(), std::ios::binary);
+		std::ofstream out(copyName.c_str(), std::ios::binary | std::ios::trunc);
+		if (!in || !out || !(out << in.rdbuf()))
+		{
+			out.close();
+			std::remove(copyName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	unsigned long mNextCopy;
+	std::vector<std::unique_ptr<ResidentTestClassFactory>> mHostFactories;
+	std::vector<std::unique_ptr<Library>> mLibraries;
+};
+
+}
+#endif
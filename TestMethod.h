@@ -1,6 +1,7 @@
 #pragma once
 #include "ITestMethod.h"
 #include "TestMethodRegister.h"
+#include "BenchmarkState.h"
 
 namespace UnitTest
 {
@@ -24,6 +25,12 @@ public:
 	}
 #pragma GCC diagnostic pop
 
+	static bool IsBenchmarkStatic()
+	{
+		//hidden by BENCHMARK_METHOD
+		return false;
+	}
+
 	virtual const char* GetTestMethodName() const
 	{
 		return TMethod::GetTestMethodNameStatic();
@@ -47,7 +54,27 @@ TestMethodRegister<T, TMethod> TestMethod<T, TMethod>::mAutoRegister;
 #define TEST_METHOD_STRINGIZE_LINE_NUMBER_CORE(lineNumber) #lineNumber
 #define TEST_METHOD_STRINGIZE_LINE_NUMBER(lineNumber) TEST_METHOD_STRINGIZE_LINE_NUMBER_CORE(lineNumber)
 
-#define TEST_METHOD(Name) \
+//Declares the static members every test method class has: its name, source location and
+//timeout, and the record registering it with TRegister (see TEST_METHOD_RECORD).
+#define TEST_METHOD_COMMON(Name, Milliseconds, TRegister) \
+		static const char* GetTestMethodNameStatic() \
+		{ \
+			return #Name; \
+		} \
+		static const char* GetTestMethodLocationStatic() \
+		{ \
+			return __FILE__ ":" TEST_METHOD_STRINGIZE_LINE_NUMBER(__LINE__) ":0"; \
+		} \
+		static unsigned long GetTestMethodTimeoutStatic() \
+		{ \
+			return Milliseconds; \
+		} \
+		TEST_METHOD_RECORD(TestMethod##Name, TRegister)
+
+#define TEST_METHOD(Name) TEST_METHOD_TIMEOUT(Name, 0)
+
+//Declares a test method that fails if it runs longer than Milliseconds (0 uses the test class timeout).
+#define TEST_METHOD_TIMEOUT(Name, Milliseconds) \
 	class TestMethod##Name : public UnitTest::TestMethod<DerivedTestClass, TestMethod##Name> \
 	{ \
 	public: \
@@ -55,20 +82,34 @@ TestMethodRegister<T, TMethod> TestMethod<T, TMethod>::mAutoRegister;
 			: UnitTest::TestMethod<DerivedTestClass, TestMethod##Name>(object) \
 		{ \
 		} \
-		static const char* GetTestMethodNameStatic() \
+		static void ExecuteStatic(DerivedTestClass& object) \
 		{ \
-			return #Name; \
+			object.Name(); \
 		} \
-		static const char* GetTestMethodLocationStatic() \
+		TEST_METHOD_COMMON(Name, Milliseconds, UnitTest::TestMethodRegister) \
+	}; \
+	void Name()
+
+//Declares a benchmark method that runs its body with a BenchmarkState named state; the
+//body must loop while state.KeepRunning().  Benchmarks only run with RunBenchmarks.
+#define BENCHMARK_METHOD(Name) \
+	class TestMethod##Name : public UnitTest::TestMethod<DerivedTestClass, TestMethod##Name> \
+	{ \
+	public: \
+		TestMethod##Name(DerivedTestClass& object) \
+			: UnitTest::TestMethod<DerivedTestClass, TestMethod##Name>(object) \
 		{ \
-			return __FILE__ ":" TEST_METHOD_STRINGIZE_LINE_NUMBER(__LINE__) ":0"; \
+		} \
+		static bool IsBenchmarkStatic() \
+		{ \
+			return true; \
 		} \
 		static void ExecuteStatic(DerivedTestClass& object) \
 		{ \
-			object.Name(); \
+			object.Name(UnitTest::BenchmarkState::GetCurrent()); \
 		} \
+		TEST_METHOD_COMMON(Name, 0, UnitTest::TestMethodRegister) \
 	}; \
-	void Name()
+	void Name(UnitTest::BenchmarkState& state)
 
 }
-
@@ -30,10 +30,22 @@ public:
 	{
 		return TMethod::GetTestMethodLocationStatic();
 	}
+	virtual unsigned long GetTestMethodTimeout() const
+	{
+		return TMethod::GetTestMethodTimeoutStatic();
+	}
+	virtual bool IsBenchmark() const
+	{
+		return TMethod::IsBenchmarkStatic();
+	}
 	virtual std::shared_ptr<ITestMethod> CreateInstance(ITestClass* object) const
 	{
 		return std::shared_ptr<ITestMethod>(new TMethod(*dynamic_cast<T*>(object)));
 	}
+	virtual void Execute(ITestClass& object) const
+	{
+		TMethod::ExecuteStatic(static_cast<T&>(object));
+	}
 };
 
 }
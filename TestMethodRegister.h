@@ -1,10 +1,28 @@
 #pragma once
 #include "TestClassFactory.h"
 #include "TestMethodFactory.h"
+#include "TestRepository.h"
 
 namespace UnitTest
 {
 
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+//Registration is done by the TestRepository from the TestMethodRecord of each test method.
+template <typename T, typename TMethod>
+class TestMethodRegister
+{
+public:
+	static void Register()
+	{
+		TestClassFactory<T>::GetInstance().Register(&TestMethodFactory<T, TMethod>::GetInstance());
+	}
+
+	static ITestClassFactory& GetClassFactory()
+	{
+		return TestClassFactory<T>::GetInstance();
+	}
+};
+#else
 template <typename T, typename TMethod>
 class TestMethodRegister
 {
@@ -14,6 +32,29 @@ public:
 		TestClassFactory<T>::GetInstance().Register(&TestMethodFactory<T, TMethod>::GetInstance());
 	}
 };
+#endif
 
 }
 
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+//Declares a member function of the test method class TMethod holding its constant
+//TestMethodRecord and a pointer to it in the unit_test_methods section (pointers keep the
+//section an array; larger objects may be padded to a bigger alignment).  TRegister is the
+//register template (TestMethodRegister or TestRowMethodRegister).  GCC ignores section
+//attributes on template members, so these are static locals of a non-template function,
+//which "used" forces to be emitted.
+#define TEST_METHOD_RECORD(TMethod, TRegister) \
+	__attribute__((used)) static const UnitTest::TestMethodRecord* GetTestMethodRecordStatic() \
+	{ \
+		static const UnitTest::TestMethodRecord record = \
+		{ \
+			&TRegister<DerivedTestClass, TMethod>::Register, \
+			&TRegister<DerivedTestClass, TMethod>::GetClassFactory, \
+			&TMethod::GetTestMethodLocationStatic \
+		}; \
+		__attribute__((used, section("unit_test_methods"))) static const UnitTest::TestMethodRecord* const entry = &record; \
+		return entry; \
+	}
+#else
+#define TEST_METHOD_RECORD(TMethod, TRegister)
+#endif
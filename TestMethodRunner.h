@@ -0,0 +1,594 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "ITestClassFactory.h"
+#include "TestResult.h"
+#include "TestTiming.h"
+#include "TestAllocations.h"
+#include "BenchmarkState.h"
+#include "TestHardwareCounters.h"
+
+namespace UnitTest
+{
+
+// TestMethodRunner executes a single step of a test class (InitializeTests, a test
+// method wrapped in BeginTest/EndTest, or TerminateTests) and converts any exception
+// into a failed TestResult.  It does not report anything so that callers can decide
+// when (and on which thread) the ITestRun callbacks are made.
+class TestMethodRunner
+{
+public:
+	static TestResult InitializeTests(ITestClassFactory& factory)
+	{
+		TestResult result(factory.GetTestClassName(), "[InitializeTests]");
+		TestPhaseTimer timer;
+		try
+		{
+			timer.Start(result.GetTiming().mMethod);
+			factory.InitializeTests();
+			result.Pass();
+		}
+		catch (const std::exception& error)
+		{
+			result.Fail(error.what());
+		}
+		catch (...)
+		{
+			result.Fail("Unhandled exception.");
+		}
+		timer.Stop();
+		return result;
+	}
+
+	static TestResult TerminateTests(ITestClassFactory& factory)
+	{
+		TestResult result(factory.GetTestClassName(), "[TerminateTests]");
+		TestPhaseTimer timer;
+		try
+		{
+			timer.Start(result.GetTiming().mMethod);
+			ReusedInstances::Release(factory);
+			factory.TerminateTests();
+			result.Pass();
+		}
+		catch (const std::exception& error)
+		{
+			result.Fail(error.what());
+		}
+		catch (...)
+		{
+			result.Fail("Unhandled exception.");
+		}
+		timer.Stop();
+		return result;
+	}
+
+	//Returns the timeout of the unit test: its own, else its test class's, else defaultTimeout.
+	static unsigned long GetTimeout(const ITestClassFactory& factory, unsigned long index, unsigned long defaultTimeout)
+	{
+		auto timeout = factory.Get(index).GetTestMethodTimeout();
+		if (timeout == 0)
+			timeout = factory.GetTestClassTimeout();
+		return timeout == 0 ? defaultTimeout : timeout;
+	}
+
+	static std::string DescribeTimeout(unsigned long timeout, const std::string& stack)
+	{
+		auto description = "Timed out after " + std::to_string(timeout) + " ms.";
+		if (!stack.empty())
+			description += "\nStack of the test thread:\n" + stack;
+		return description;
+	}
+
+	//With allocation tracking the allocations are counted from constructing the test class
+	//instance until it is destroyed after EndTest; with counters the hardware events are
+	//counted while the test method runs (see TestHardwareCounters).
+	static TestResult RunTestMethod(
+		ITestClassFactory& factory,
+		unsigned long index,
+		TestAllocations::ModeEnum allocations = TestAllocations::Off,
+		bool counters = false)
+	{
+		auto& mfactory = factory.Get(index);
+		TestResult result(factory.GetTestClassName(), mfactory.GetTestMethodName());
+		auto& timing = result.GetTiming();
+		TestPhaseTimer timer;
+		auto passed = false;
+		std::string failure;
+		if (allocations != TestAllocations::Off)
+			TestAllocations::Begin();
+		try
+		{
+			Execute(factory, mfactory, timing, timer, counters ? &timing.mCounters : nullptr);
+			passed = true;
+		}
+		catch (const std::exception& error)
+		{
+			//The runner's copy of the failure outlives the unit test, so it is not counted.
+			TestAllocationPause pause;
+			failure = error.what();
+		}
+		catch (...)
+		{
+			TestAllocationPause pause;
+			failure = "Unhandled exception.";
+		}
+		timer.Stop();
+
+		if (allocations != TestAllocations::Off)
+		{
+			timing.mAllocations = TestAllocations::End();
+			if (passed && allocations == TestAllocations::FailOnLeaks && timing.mAllocations.GetLeakedAllocations() != 0)
+			{
+				passed = false;
+				failure = "Leaked " + std::to_string(timing.mAllocations.GetLeakedAllocations()) + " allocation(s) of "
+					+ std::to_string(timing.mAllocations.GetLeakedBytes()) + " byte(s).";
+			}
+		}
+		if (passed)
+			result.Pass();
+		else
+			result.Fail(failure);
+		return result;
+	}
+
+	//Runs the unit test repeatCount times, spread over threadCount threads running at the same
+	//time, each run with a new (or reset) test class instance.  The result passes only if
+	//every run passed; its timing is that of the median run plus the TestRepeatStatistics.
+	static TestResult RunTestMethod(
+		ITestClassFactory& factory,
+		unsigned long index,
+		TestAllocations::ModeEnum allocations,
+		bool counters,
+		unsigned long repeatCount,
+		unsigned long threadCount)
+	{
+		if (repeatCount <= 1 && threadCount <= 1)
+			return RunTestMethod(factory, index, allocations, counters);
+		if (repeatCount < threadCount)
+			repeatCount = threadCount;
+
+		std::vector<TestResult> runs(repeatCount);
+		std::atomic<unsigned long> next(0);
+		auto runner = [&]()
+		{
+			for (auto run = next++; run < repeatCount; run = next++)
+				runs[run] = RunTestMethod(factory, index, allocations, counters);
+		};
+		std::vector<std::thread> threads;
+		for (auto thread = 1ul; thread < threadCount; ++thread)
+			threads.push_back(std::thread(runner));
+		runner();
+		for (auto& thread : threads)
+			thread.join();
+		return Summarize(runs, threadCount < 1 ? 1 : threadCount);
+	}
+
+	//Runs a BENCHMARK_METHOD: the iteration count is doubled (or scaled up from the measured
+	//time) until one run of the loop takes at least sampleMilliseconds, runs of that length
+	//are repeated until warmupMilliseconds have passed since the start and then sampleCount
+	//runs are timed.  Every run uses a new (or reset) test class instance with BeginTest and
+	//EndTest.  With counters the hardware events of the timed runs are counted.
+	static TestResult RunBenchmarkMethod(
+		ITestClassFactory& factory,
+		unsigned long index,
+		unsigned long sampleCount,
+		unsigned long sampleMilliseconds,
+		unsigned long warmupMilliseconds,
+		bool counters = false)
+	{
+		static const unsigned long long MaxIterations = 1000000000ull;
+		auto& mfactory = factory.Get(index);
+		TestResult result(factory.GetTestClassName(), mfactory.GetTestMethodName());
+		auto& timing = result.GetTiming();
+		TestPhaseTimer timer;
+		try
+		{
+			auto start = std::chrono::steady_clock::now();
+			auto sampleNanoseconds = sampleMilliseconds * 1000000.0;
+			unsigned long long iterations = 1;
+			for (;;)
+			{
+				auto elapsed = static_cast<double>(ExecuteBenchmark(factory, mfactory, iterations, timing, timer, nullptr));
+				if (elapsed >= sampleNanoseconds || iterations >= MaxIterations)
+					break;
+				auto scale = elapsed <= 0 ? 10.0 : std::min(10.0, std::max(2.0, 1.4 * sampleNanoseconds / elapsed));
+				iterations = std::min(MaxIterations, static_cast<unsigned long long>(iterations * scale));
+			}
+			auto warmup = std::chrono::milliseconds(warmupMilliseconds);
+			while (std::chrono::steady_clock::now() - start < warmup)
+				ExecuteBenchmark(factory, mfactory, iterations, timing, timer, nullptr);
+
+			std::vector<double> samples;
+			for (auto sample = 0ul; sample < std::max(sampleCount, 1ul); ++sample)
+				samples.push_back(static_cast<double>(ExecuteBenchmark(factory, mfactory, iterations, timing, timer,
+					counters ? &timing.mCounters : nullptr)) / iterations);
+			Summarize(samples, iterations, timing.mBenchmark);
+			result.Pass();
+		}
+		catch (const std::exception& error)
+		{
+			result.Fail(error.what());
+		}
+		catch (...)
+		{
+			result.Fail("Unhandled exception.");
+		}
+		timer.Stop();
+		return result;
+	}
+
+private:
+	static TestResult Summarize(std::vector<TestResult>& runs, unsigned long threadCount)
+	{
+		unsigned long passedRuns = 0;
+		std::string firstFailure;
+		for (auto& run : runs)
+			if (run.GetPassed())
+				++passedRuns;
+			else if (firstFailure.empty())
+				firstFailure = run.GetDescription();
+
+		std::sort(runs.begin(), runs.end(), [](const TestResult& lhs, const TestResult& rhs)
+		{
+			return lhs.GetTiming().GetTotal().mWallNanoseconds < rhs.GetTiming().GetTotal().mWallNanoseconds;
+		});
+		//Nearest rank percentile of the sorted run durations.
+		auto percentile = [&](unsigned long percent)
+		{
+			auto rank = (runs.size() * percent + 99) / 100;
+			return runs[rank == 0 ? 0 : rank - 1].GetTiming().GetTotal().mWallNanoseconds;
+		};
+
+		auto& median = runs[(runs.size() - 1) / 2];
+		TestResult result(median.GetTestClass(), median.GetTestMethod());
+		result.GetTiming() = median.GetTiming();
+		auto& repeat = result.GetTiming().mRepeat;
+		repeat.mRuns = runs.size();
+		repeat.mPassedRuns = passedRuns;
+		repeat.mThreadCount = threadCount;
+		repeat.mMinNanoseconds = runs.front().GetTiming().GetTotal().mWallNanoseconds;
+		repeat.mMedianNanoseconds = percentile(50);
+		repeat.mP99Nanoseconds = percentile(99);
+		repeat.mMaxNanoseconds = runs.back().GetTiming().GetTotal().mWallNanoseconds;
+		if (passedRuns == runs.size())
+			result.Pass();
+		else
+			result.Fail("Failed " + std::to_string(runs.size() - passedRuns) + " of "
+				+ std::to_string(runs.size()) + " run(s); first failure:\n" + firstFailure);
+		return result;
+	}
+
+	static void Summarize(std::vector<double>& samples, unsigned long long iterations, TestBenchmarkStatistics& benchmark)
+	{
+		std::sort(samples.begin(), samples.end());
+		auto middle = samples.size() / 2;
+		auto sum = 0.0;
+		for (auto sample : samples)
+			sum += sample;
+		auto mean = sum / samples.size();
+		auto squares = 0.0;
+		for (auto sample : samples)
+			squares += (sample - mean) * (sample - mean);
+
+		benchmark.mSamples = samples.size();
+		benchmark.mIterations = iterations;
+		benchmark.mSampleNanoseconds = samples;
+		benchmark.mMeanNanoseconds = mean;
+		benchmark.mMedianNanoseconds = samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+		benchmark.mStandardDeviationNanoseconds = samples.size() < 2 ? 0 : std::sqrt(squares / (samples.size() - 1));
+	}
+
+	//Runs the benchmark loop for iterations iterations and returns the time it took.
+	static unsigned long long ExecuteBenchmark(
+		ITestClassFactory& factory,
+		ITestMethodFactory& mfactory,
+		unsigned long long iterations,
+		TestTiming& timing,
+		TestPhaseTimer& timer,
+		TestHardwareCounts* counters)
+	{
+		BenchmarkState state(iterations);
+		BenchmarkState::Scope scope(state);
+		Execute(factory, mfactory, timing, timer, counters);
+		timer.Stop();
+		if (!state.IsComplete())
+			throw std::runtime_error("The benchmark did not loop while state.KeepRunning() returned true.");
+		return state.GetElapsedNanoseconds();
+	}
+
+	// InstanceStorage is the storage the test class instances of a thread are constructed
+	// in, so that running a unit test allocates nothing once the storage has grown to fit.
+	// A nested run on the same thread (a unit test running unit tests) gets its own storage.
+	class InstanceStorage
+	{
+	public:
+		InstanceStorage()
+			: mSize(0), mInUse(false)
+		{
+		}
+
+		InstanceStorage(const InstanceStorage& rhs) = delete;
+		InstanceStorage& operator=(const InstanceStorage& rhs) = delete;
+
+		//Not counted as an allocation of the running unit test since it outlives it.
+		void* Acquire(std::size_t size, std::size_t alignment)
+		{
+			mInUse = true;
+			auto required = size + alignment;
+			if (required > mSize)
+			{
+				TestAllocationPause pause;
+				mBuffer.reset(new char[required]);
+				mSize = required;
+			}
+			auto address = reinterpret_cast<std::uintptr_t>(mBuffer.get());
+			return mBuffer.get() + (alignment - address % alignment) % alignment;
+		}
+
+		void Release()
+		{
+			mInUse = false;
+		}
+
+		//Read by other threads for a ReusedInstance (see ReusedInstances::Release).
+		bool IsInUse() const
+		{
+			return mInUse;
+		}
+
+	private:
+		std::unique_ptr<char[]> mBuffer;
+		std::size_t mSize;
+		std::atomic<bool> mInUse;
+	};
+
+	// ReusedInstance is the instance a thread keeps for the unit tests of a test class that
+	// reuses its instance (see TestClass::ReuseInstance).  An abandoned instance belonged to
+	// a unit test that was still running when its test class was terminated; it is leaked
+	// rather than destroyed after TerminateTests.
+	class ReusedInstance
+	{
+	public:
+		ReusedInstance(ITestClassFactory& factory)
+			: mFactory(factory), mInstance(nullptr), mAbandoned(false)
+		{
+		}
+
+		ReusedInstance(const ReusedInstance& rhs) = delete;
+		ReusedInstance& operator=(const ReusedInstance& rhs) = delete;
+
+		void Destroy()
+		{
+			if (mInstance == nullptr)
+				return;
+			if (!mAbandoned)
+				mFactory.DestroyInstance(mInstance);
+			mInstance = nullptr;
+		}
+
+		ITestClassFactory& mFactory;
+		InstanceStorage mStorage;
+		ITestClass* mInstance;
+		std::atomic<bool> mAbandoned;
+	};
+
+	// ReusedInstances holds the reused instances of the calling thread until TerminateTests
+	// of their test class releases them (or the thread exits).  The instances of all threads
+	// are listed under a mutex for Release.  Looking up the instance of a thread is not
+	// locked: Release runs once every unit test of the class completed or timed out, and
+	// it leaves the instances still in use by a timed out unit test to their thread.
+	class ReusedInstances
+	{
+	public:
+		ReusedInstances()
+		{
+		}
+
+		~ReusedInstances()
+		{
+			std::lock_guard<std::mutex> lock(GetMutex());
+			auto& all = GetAll();
+			for (auto& reused : mInstances)
+			{
+				reused->Destroy();
+				all.erase(std::find(all.begin(), all.end(), reused.get()));
+			}
+		}
+
+		ReusedInstances(const ReusedInstances& rhs) = delete;
+		ReusedInstances& operator=(const ReusedInstances& rhs) = delete;
+
+		static ReusedInstance& Get(ITestClassFactory& factory)
+		{
+			static thread_local ReusedInstances instances;
+			for (auto& reused : instances.mInstances)
+				if (&reused->mFactory == &factory)
+					return *reused;
+			TestAllocationPause pause;
+			instances.mInstances.push_back(std::unique_ptr<ReusedInstance>(new ReusedInstance(factory)));
+			std::lock_guard<std::mutex> lock(GetMutex());
+			GetAll().push_back(instances.mInstances.back().get());
+			return *instances.mInstances.back();
+		}
+
+		//Destroys the reused instances of the test class on every thread, except those of
+		//threads still running a unit test that timed out, which are abandoned.
+		static void Release(ITestClassFactory& factory)
+		{
+			std::lock_guard<std::mutex> lock(GetMutex());
+			for (auto reused : GetAll())
+			{
+				if (&reused->mFactory != &factory)
+					continue;
+				if (reused->mStorage.IsInUse())
+					reused->mAbandoned = true;
+				else
+					reused->Destroy();
+			}
+		}
+
+	private:
+		static std::mutex& GetMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		static std::vector<ReusedInstance*>& GetAll()
+		{
+			static std::vector<ReusedInstance*> all;
+			return all;
+		}
+
+	private:
+		std::vector<std::unique_ptr<ReusedInstance>> mInstances;
+	};
+
+	// TestInstance constructs a test class instance in the InstanceStorage of the calling
+	// thread and destroys it when it goes out of scope.  For a test class that reuses its
+	// instance the instance of the thread is reset instead, or constructed (without counting
+	// its allocations, as it outlives the unit test) if there is none; it is only destroyed
+	// if the unit test did not Complete, so a failed unit test does not pass its state on.
+	class TestInstance
+	{
+	public:
+		TestInstance(ITestClassFactory& factory)
+			: mFactory(factory), mStorage(&GetStorage()), mReused(nullptr), mInstance(nullptr), mCompleted(false)
+		{
+			if (factory.IsInstanceReused())
+			{
+				auto& reused = ReusedInstances::Get(factory);
+				//A nested run of the same test class gets an instance of its own.
+				if (!reused.mStorage.IsInUse())
+				{
+					Reuse(reused);
+					return;
+				}
+			}
+			if (mStorage->IsInUse())
+			{
+				mNested.reset(new InstanceStorage());
+				mStorage = mNested.get();
+			}
+			auto storage = mStorage->Acquire(factory.GetInstanceSize(), factory.GetInstanceAlignment());
+			try
+			{
+				mInstance = factory.ConstructInstance(storage);
+			}
+			catch (...)
+			{
+				mStorage->Release();
+				throw;
+			}
+		}
+
+		~TestInstance()
+		{
+			if (mReused == nullptr)
+				mFactory.DestroyInstance(mInstance);
+			else if (!mCompleted)
+				mReused->Destroy();
+			mStorage->Release();
+		}
+
+		TestInstance(const TestInstance& rhs) = delete;
+		TestInstance& operator=(const TestInstance& rhs) = delete;
+
+		ITestClass& Get() const
+		{
+			return *mInstance;
+		}
+
+		void Complete()
+		{
+			mCompleted = true;
+		}
+
+	private:
+		void Reuse(ReusedInstance& reused)
+		{
+			mReused = &reused;
+			mStorage = &reused.mStorage;
+			auto storage = mStorage->Acquire(mFactory.GetInstanceSize(), mFactory.GetInstanceAlignment());
+			try
+			{
+				if (reused.mInstance == nullptr)
+				{
+					TestAllocationPause pause;
+					reused.mInstance = mFactory.ConstructInstance(storage);
+					reused.mAbandoned = false;
+				}
+				else
+					reused.mInstance->Reset();
+			}
+			catch (...)
+			{
+				reused.Destroy();
+				mStorage->Release();
+				throw;
+			}
+			mInstance = reused.mInstance;
+		}
+
+		static InstanceStorage& GetStorage()
+		{
+			static thread_local InstanceStorage storage;
+			return storage;
+		}
+
+	private:
+		ITestClassFactory& mFactory;
+		InstanceStorage* mStorage;
+		std::unique_ptr<InstanceStorage> mNested;
+		ReusedInstance* mReused;
+		ITestClass* mInstance;
+		bool mCompleted;
+	};
+
+	//Counts the hardware events of the test method into counters unless it is null.
+	static void Execute(
+		ITestClassFactory& factory,
+		ITestMethodFactory& mfactory,
+		TestTiming& timing,
+		TestPhaseTimer& timer,
+		TestHardwareCounts* counters)
+	{
+		timer.Start(timing.mBeginTest);
+		TestInstance instance(factory);
+		try
+		{
+			instance.Get().BeginTest();
+			timer.Start(timing.mMethod);
+			if (counters != nullptr)
+				TestHardwareCounters::Start();
+			mfactory.Execute(instance.Get());
+			if (counters != nullptr)
+				TestHardwareCounters::Stop(*counters);
+		}
+		catch (...)
+		{
+			if (counters != nullptr)
+				TestHardwareCounters::Stop(*counters);
+			timer.Start(timing.mEndTest);
+			instance.Get().EndTest();
+			throw;
+		}
+		timer.Start(timing.mEndTest);
+		instance.Get().EndTest();
+		instance.Complete();
+	}
+};
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+
+namespace UnitTest
+{
+
+// TestOutputBuffer collects reporter output in memory and writes it to the stream
+// in large blocks, so that reporters do not pay for a stream flush per event.  The
+// buffer is written when it exceeds its capacity, on Flush and on destruction.
+//
+// Example:
+//	TestOutputBuffer out(file);
+//	out << "<testcase name=\"" << name << "\"/>\n";
+//	out.Flush();
+class TestOutputBuffer
+{
+public:
+	TestOutputBuffer(std::ostream& out, std::size_t capacity = 64 * 1024)
+		: mOut(out), mCapacity(capacity)
+	{
+		mBuffer.reserve(capacity);
+	}
+
+	~TestOutputBuffer()
+	{
+		Flush();
+	}
+
+	TestOutputBuffer(const TestOutputBuffer& rhs) = delete;
+	TestOutputBuffer& operator=(const TestOutputBuffer& rhs) = delete;
+
+	TestOutputBuffer& operator<<(const std::string& text)
+	{
+		mBuffer.append(text);
+		return Written();
+	}
+
+	TestOutputBuffer& operator<<(const char* text)
+	{
+		mBuffer.append(text);
+		return Written();
+	}
+
+	TestOutputBuffer& operator<<(char value)
+	{
+		mBuffer.push_back(value);
+		return Written();
+	}
+
+	TestOutputBuffer& operator<<(unsigned long long value)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%llu", value);
+		return *this << text;
+	}
+
+	TestOutputBuffer& operator<<(unsigned long value)
+	{
+		return *this << static_cast<unsigned long long>(value);
+	}
+
+	//Writes value with a fixed number of decimals.
+	TestOutputBuffer& WriteFixed(double value, int precision)
+	{
+		char text[64];
+		std::snprintf(text, sizeof(text), "%.*f", precision, value);
+		return *this << text;
+	}
+
+	void Flush()
+	{
+		if (!mBuffer.empty())
+			mOut.write(mBuffer.data(), mBuffer.size());
+		mOut.flush();
+		mBuffer.clear();
+	}
+
+private:
+	TestOutputBuffer& Written()
+	{
+		if (mBuffer.size() >= mCapacity)
+		{
+			mOut.write(mBuffer.data(), mBuffer.size());
+			mBuffer.clear();
+		}
+		return *this;
+	}
+
+private:
+	std::ostream& mOut;
+	std::size_t mCapacity;
+	std::string mBuffer;
+};
+
+}
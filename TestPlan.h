@@ -0,0 +1,145 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include "ITestClassFactory.h"
+#include "TestRepository.h"
+
+namespace UnitTest
+{
+
+// TestPlanClass is a test class factory together with the indexes of the test
+// methods (in ITestClassFactory::Get order) that will be run for that class.
+class TestPlanClass
+{
+public:
+	TestPlanClass(ITestClassFactory& factory)
+		: mFactory(&factory)
+	{
+	}
+
+	ITestClassFactory* mFactory;
+	std::vector<unsigned long> mMethods;
+};
+
+// TestPlan is the ordered list of test classes and test methods that a single
+// call to TestRunner::RunTests will execute.
+class TestPlan
+{
+public:
+	static TestPlan FromRepository()
+	{
+		TestPlan plan;
+		auto& repository = TestRepository::GetInstance();
+		for (auto classIndex = 0ul; classIndex < repository.GetCount(); ++classIndex)
+		{
+			auto& entry = plan.Add(repository.Get(classIndex));
+			auto count = entry.mFactory->GetCount();
+			entry.mMethods.reserve(count);
+			for (auto methodIndex = 0ul; methodIndex < count; ++methodIndex)
+				entry.mMethods.push_back(methodIndex);
+		}
+		return plan;
+	}
+
+	TestPlanClass& Add(ITestClassFactory& factory)
+	{
+		mClasses.push_back(TestPlanClass(factory));
+		return mClasses.back();
+	}
+
+	unsigned long GetCount() const
+	{
+		return mClasses.size();
+	}
+
+	const TestPlanClass& Get(unsigned long index) const
+	{
+		return mClasses[index];
+	}
+
+	TestPlanClass& Get(unsigned long index)
+	{
+		return mClasses[index];
+	}
+
+	//Keeps only the test methods for which filter(factory, methodIndex) returns true
+	//and removes the test classes that are left without any test methods.
+	template <typename TFilter>
+	void Filter(TFilter filter)
+	{
+		std::vector<TestPlanClass> classes;
+		for (auto& entry : mClasses)
+		{
+			TestPlanClass selected(*entry.mFactory);
+			for (auto index : entry.mMethods)
+				if (filter(*entry.mFactory, index))
+					selected.mMethods.push_back(index);
+			if (!selected.mMethods.empty())
+				classes.push_back(std::move(selected));
+		}
+		mClasses.swap(classes);
+	}
+
+	//Moves the test methods for which prioritize(factory, methodIndex) returns true to the
+	//front of their test class and those test classes to the front of the plan, otherwise
+	//keeping the current order.
+	template <typename TPrioritize>
+	void Prioritize(TPrioritize prioritize)
+	{
+		std::vector<bool> prioritized;
+		for (auto& entry : mClasses)
+		{
+			auto middle = std::stable_partition(entry.mMethods.begin(), entry.mMethods.end(), [&](unsigned long index)
+			{
+				return prioritize(static_cast<const ITestClassFactory&>(*entry.mFactory), index);
+			});
+			prioritized.push_back(middle != entry.mMethods.begin());
+		}
+
+		std::vector<TestPlanClass> classes;
+		classes.reserve(mClasses.size());
+		for (auto pass = 0; pass < 2; ++pass)
+			for (auto index = 0ul; index < mClasses.size(); ++index)
+				if (prioritized[index] == (pass == 0))
+					classes.push_back(std::move(mClasses[index]));
+		mClasses.swap(classes);
+	}
+
+	//Randomizes the order of the test classes and of the test methods within each test class.
+	//The same seed always gives the same order, on every platform.
+	void Shuffle(std::uint64_t seed)
+	{
+		std::mt19937_64 random(seed);
+		Shuffle(mClasses, random);
+		for (auto& entry : mClasses)
+			Shuffle(entry.mMethods, random);
+	}
+
+	unsigned long GetMethodCount() const
+	{
+		unsigned long count = 0;
+		for (auto& entry : mClasses)
+			count += entry.mMethods.size();
+		return count;
+	}
+
+private:
+	//Fisher-Yates shuffle; std::shuffle and std::uniform_int_distribution are not used since
+	//their results differ between standard library implementations.
+	template <typename TItem>
+	static void Shuffle(std::vector<TItem>& items, std::mt19937_64& random)
+	{
+		for (auto index = items.size(); index > 1; --index)
+		{
+			auto other = static_cast<std::size_t>(random() % index);
+			std::swap(items[index - 1], items[other]);
+		}
+	}
+
+private:
+	std::vector<TestPlanClass> mClasses;
+};
+
+}
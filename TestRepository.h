@@ -1,16 +1,55 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include "TestClassFactory.h"
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+#include <string>
+#include <cstdlib>
+#include <unordered_set>
+#endif
 
 namespace UnitTest
 {
 
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+// TestMethodRecord is the constant descriptor of one test method; the section registry
+// places a pointer to it in the unit_test_methods ELF section (see TEST_METHOD_RECORD).
+class TestMethodRecord
+{
+public:
+	void (*mRegister)();
+	ITestClassFactory& (*mGetClassFactory)();
+	const char* (*mGetLocation)();
+};
+#endif
+
+}
+
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+//Defined by the linker for the unit_test_methods section (null if it is empty).
+extern "C" const UnitTest::TestMethodRecord* const __start_unit_test_methods[] __attribute__((weak));
+extern "C" const UnitTest::TestMethodRecord* const __stop_unit_test_methods[] __attribute__((weak));
+#endif
+
+namespace UnitTest
+{
+
+// TestRepository holds the registered test classes.  By default test classes and test
+// methods register themselves during static initialization.  With
+// UNIT_TEST_SECTION_REGISTRY defined (GCC or Clang on ELF platforms) each test method
+// instead emits a constant TestMethodRecord referenced from the unit_test_methods section
+// and the records are registered when the repository is first used, ordered by source
+// file and line, so startup does no registration work.
 class TestRepository
 {
 private:
 	TestRepository()
+		: mGeneration(0)
 	{
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+		RegisterSection();
+#endif
 	}
 	~TestRepository()
 	{
@@ -26,7 +65,27 @@ public:
 	template <typename T>
 	void Register()
 	{
-		mFactories.push_back(&TestClassFactory<T>::GetInstance());
+		Register(TestClassFactory<T>::GetInstance());
+	}
+
+	void Register(ITestClassFactory& factory)
+	{
+		mFactories.push_back(&factory);
+		++mGeneration;
+	}
+
+	//Replaces the registration at index (e.g. with a decorating factory).
+	void Replace(unsigned long index, ITestClassFactory& factory)
+	{
+		mFactories[index] = &factory;
+		++mGeneration;
+	}
+
+	//Removes the registration of factory (e.g. before unloading the library defining it).
+	void Remove(ITestClassFactory& factory)
+	{
+		mFactories.erase(std::remove(mFactories.begin(), mFactories.end(), &factory), mFactories.end());
+		++mGeneration;
 	}
 
 	unsigned long GetCount() const
@@ -39,8 +98,52 @@ public:
 		return *mFactories[index];
 	}
 
+	//Changes whenever the registered test classes change (used to invalidate TestIndex).
+	unsigned long GetGeneration() const
+	{
+		return mGeneration;
+	}
+
+private:
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+	void RegisterSection()
+	{
+		if (__start_unit_test_methods == nullptr || __stop_unit_test_methods == nullptr)
+			return;
+		std::vector<const TestMethodRecord*> records;
+		for (auto entry = __start_unit_test_methods; entry != __stop_unit_test_methods; ++entry)
+			records.push_back(*entry);
+		//The link order of the records is unspecified, so they are put in source order.
+		std::stable_sort(records.begin(), records.end(), [](const TestMethodRecord* lhs, const TestMethodRecord* rhs)
+		{
+			return IsBefore(lhs->mGetLocation(), rhs->mGetLocation());
+		});
+
+		std::unordered_set<ITestClassFactory*> registered;
+		for (auto record : records)
+		{
+			record->mRegister();
+			auto& factory = record->mGetClassFactory();
+			if (registered.insert(&factory).second)
+				Register(factory);
+		}
+	}
+
+	//Compares "file:line:column" locations by file and then by line number.
+	static bool IsBefore(const std::string& lhs, const std::string& rhs)
+	{
+		auto lhsLine = lhs.rfind(':', lhs.rfind(':') - 1);
+		auto rhsLine = rhs.rfind(':', rhs.rfind(':') - 1);
+		auto file = lhs.compare(0, lhsLine, rhs, 0, rhsLine);
+		if (file != 0)
+			return file < 0;
+		return std::strtoul(lhs.c_str() + lhsLine + 1, nullptr, 10) < std::strtoul(rhs.c_str() + rhsLine + 1, nullptr, 10);
+	}
+#endif
+
 private:
 	std::vector<ITestClassFactory*> mFactories;
+	unsigned long mGeneration;
 };
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "TestTiming.h"
 
 namespace UnitTest
 {
@@ -28,7 +29,8 @@ public:
 		: mTestClass(rhs.mTestClass),
 		mTestMethod(rhs.mTestMethod),
 		mPassed(rhs.mPassed),
-		mDescription(rhs.mDescription)
+		mDescription(rhs.mDescription),
+		mTiming(rhs.mTiming)
 	{
 	}
 
@@ -44,6 +46,7 @@ public:
 			mTestMethod = rhs.mTestMethod;
 			mPassed = rhs.mPassed;
 			mDescription = rhs.mDescription;
+			mTiming = rhs.mTiming;
 		}
 		return *this;
 	}
@@ -64,6 +67,14 @@ public:
 	{
 		return mDescription;
 	}
+	const TestTiming& GetTiming() const
+	{
+		return mTiming;
+	}
+	TestTiming& GetTiming()
+	{
+		return mTiming;
+	}
 
 	void Pass()
 	{
@@ -81,6 +92,7 @@ private:
 	const char* mTestMethod;
 	bool mPassed;
 	std::string mDescription;
+	TestTiming mTiming;
 };
 
 }
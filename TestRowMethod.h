@@ -0,0 +1,236 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <exception>
+#include <cstddef>
+#include "ITestMethod.h"
+#include "ITestMethodFactory.h"
+#include "TestClassFactory.h"
+#include "TestRepository.h"
+#include "TestMethod.h"
+
+namespace UnitTest
+{
+
+// TestRowMethodFactory creates the test method of one row of a TEST_METHOD_ROWS, which is
+// a unit test of its own named "Name[row]".  A row source that threw is registered as a
+// single unit test "Name[rows]" that fails with the error.
+template <typename T, typename TMethod>
+class TestRowMethodFactory : public ITestMethodFactory
+{
+public:
+	TestRowMethodFactory(unsigned long row)
+		: mRow(row), mName(std::string(TMethod::GetTestMethodNameStatic()) + "[" + std::to_string(row) + "]")
+	{
+	}
+
+	TestRowMethodFactory(const std::string& error)
+		: mRow(0), mName(std::string(TMethod::GetTestMethodNameStatic()) + "[rows]"), mError(error)
+	{
+	}
+
+	virtual const char* GetTestMethodName() const
+	{
+		return mName.c_str();
+	}
+	virtual const char* GetTestMethodLocation() const
+	{
+		return TMethod::GetTestMethodLocationStatic();
+	}
+	virtual unsigned long GetTestMethodTimeout() const
+	{
+		return TMethod::GetTestMethodTimeoutStatic();
+	}
+	virtual bool IsBenchmark() const
+	{
+		return false;
+	}
+	virtual std::shared_ptr<ITestMethod> CreateInstance(ITestClass* object) const
+	{
+		ThrowIfFailed();
+		return std::shared_ptr<ITestMethod>(new TMethod(*dynamic_cast<T*>(object), mRow));
+	}
+	virtual void Execute(ITestClass& object) const
+	{
+		ThrowIfFailed();
+		TMethod::ExecuteStatic(static_cast<T&>(object), mRow);
+	}
+
+private:
+	void ThrowIfFailed() const
+	{
+		if (!mError.empty())
+			throw std::runtime_error("Unable to get the rows: " + mError);
+	}
+
+private:
+	unsigned long mRow;
+	std::string mName;
+	std::string mError;
+};
+
+// TestRowMethodRegister registers one TestRowMethodFactory per row of the test method.
+template <typename T, typename TMethod>
+class TestRowMethodRegister
+{
+public:
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+	static void Register()
+#else
+	TestRowMethodRegister()
+#endif
+	{
+		auto& factories = GetFactories();
+		try
+		{
+			auto count = TMethod::GetRowsStatic().size();
+			for (auto row = 0ul; row < count; ++row)
+				factories.push_back(std::unique_ptr<TestRowMethodFactory<T, TMethod>>(new TestRowMethodFactory<T, TMethod>(row)));
+		}
+		catch (const std::exception& error)
+		{
+			factories.push_back(std::unique_ptr<TestRowMethodFactory<T, TMethod>>(new TestRowMethodFactory<T, TMethod>(std::string(error.what()))));
+		}
+		for (auto& factory : factories)
+			TestClassFactory<T>::GetInstance().Register(factory.get());
+	}
+
+#if defined(UNIT_TEST_SECTION_REGISTRY)
+	static ITestClassFactory& GetClassFactory()
+	{
+		return TestClassFactory<T>::GetInstance();
+	}
+#endif
+
+private:
+	static std::vector<std::unique_ptr<TestRowMethodFactory<T, TMethod>>>& GetFactories()
+	{
+		static std::vector<std::unique_ptr<TestRowMethodFactory<T, TMethod>>> factories;
+		return factories;
+	}
+};
+
+// TestRowMethod is the base of the test method class declared by TEST_METHOD_ROWS; it runs
+// the test method with one row.
+template <typename T, typename TMethod>
+class TestRowMethod : public ITestMethod
+{
+public:
+#if !defined(UNIT_TEST_SECTION_REGISTRY)
+	static TestRowMethodRegister<T, TMethod> mAutoRegister;
+#endif
+
+	TestRowMethod(T& object, unsigned long row)
+		: mObject(object), mRow(row)
+	{
+	}
+	virtual ~TestRowMethod()
+	{
+#if !defined(UNIT_TEST_SECTION_REGISTRY)
+//The following "seemingly" unused variable reference is required for automatic registration.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-value"
+		mAutoRegister;
+#pragma GCC diagnostic pop
+#endif
+	}
+
+	virtual const char* GetTestMethodName() const
+	{
+		return TMethod::GetTestMethodNameStatic();
+	}
+	virtual const char* GetTestMethodLocation() const
+	{
+		return TMethod::GetTestMethodLocationStatic();
+	}
+	virtual void Execute() const
+	{
+		TMethod::ExecuteStatic(mObject, mRow);
+	}
+
+private:
+	T& mObject;
+	unsigned long mRow;
+};
+
+#if !defined(UNIT_TEST_SECTION_REGISTRY)
+template <typename T, typename TMethod>
+TestRowMethodRegister<T, TMethod> TestRowMethod<T, TMethod>::mAutoRegister;
+#endif
+
+//Returns the rows of a static array as the row source of a TEST_METHOD_ROWS.
+template <typename TRow, std::size_t Count>
+std::vector<TRow> Rows(const TRow (&rows)[Count])
+{
+	return std::vector<TRow>(rows, rows + Count);
+}
+
+//Parses one row of ReadRows.
+template <typename TRow>
+bool ReadRow(std::istringstream& fields, TRow& row)
+{
+	return static_cast<bool>(fields >> row);
+}
+
+inline bool ReadRow(std::istringstream& fields, std::string& row)
+{
+	row = fields.str();
+	return true;
+}
+
+//Reads the rows of a TEST_METHOD_ROWS from a text file, one row per line parsed with
+//operator>> (a std::string row is the whole line).  Empty lines and lines starting with #
+//are skipped.  Throws if the file cannot be read or a line cannot be parsed.
+template <typename TRow>
+std::vector<TRow> ReadRows(const std::string& fileName)
+{
+	std::ifstream in(fileName.c_str());
+	if (!in)
+		throw std::runtime_error("unable to read " + fileName + ".");
+	std::vector<TRow> rows;
+	std::string line;
+	for (auto number = 1ul; std::getline(in, line); ++number)
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		TRow row;
+		if (!ReadRow(fields, row))
+			throw std::runtime_error("unable to parse line " + std::to_string(number) + " of " + fileName + ".");
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+//Declares a data driven test method that runs once for every row of the row source, an
+//expression converting to std::vector<TRow> such as a braced list of rows, Rows(array),
+//a call of a generator function or ReadRows<TRow>(fileName).  The body receives the row as
+//row.  Every row is a separate unit test named Name[index], so rows are filtered, reported
+//and scheduled on the thread pool individually.  The row source is evaluated once, when
+//the test method is registered.
+#define TEST_METHOD_ROWS(Name, TRow, ...) \
+	class TestMethod##Name : public UnitTest::TestRowMethod<DerivedTestClass, TestMethod##Name> \
+	{ \
+	public: \
+		TestMethod##Name(DerivedTestClass& object, unsigned long row) \
+			: UnitTest::TestRowMethod<DerivedTestClass, TestMethod##Name>(object, row) \
+		{ \
+		} \
+		static const std::vector<TRow>& GetRowsStatic() \
+		{ \
+			static const std::vector<TRow> rows = __VA_ARGS__; \
+			return rows; \
+		} \
+		static void ExecuteStatic(DerivedTestClass& object, unsigned long row) \
+		{ \
+			object.Name(GetRowsStatic()[row]); \
+		} \
+		TEST_METHOD_COMMON(Name, 0, UnitTest::TestRowMethodRegister) \
+	}; \
+	void Name(const TRow& row)
+
+}
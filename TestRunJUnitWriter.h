@@ -0,0 +1,168 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ITestRun.h"
+#include "TestTiming.h"
+#include "TestOutputBuffer.h"
+
+namespace UnitTest
+{
+
+// TestRunJUnitWriter writes the run as JUnit XML: one <testsuite> per test class and
+// one <testcase> per unit test with its duration in seconds and, for failures, a
+// <failure> element holding the description.  A test class is written when it ends,
+// so the file grows as the run progresses.  A failed InitializeTests or TerminateTests
+// is written as a failed test case named "[InitializeTests]" or "[TerminateTests]";
+// passing ones are omitted.  The unit tests of a class whose InitializeTests failed are
+// counted as failed by the runner, so they are written as failed test cases too; their
+// names are not reported, so they are named "[Not run N]".  Messages are written as XML comments.  The XML declaration
+// is written on construction so that a message arriving first still follows it.
+//
+// Example:
+//	std::ofstream file("TestResults.xml");
+//	TestRunJUnitWriter writer(file);
+//	TestRunner::RunTests(writer);
+class TestRunJUnitWriter : public ITestRun
+{
+public:
+	TestRunJUnitWriter(std::ostream& out)
+		: mOut(out), mMethodCount(0)
+	{
+		mOut << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mOut << "<testsuites>\n";
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mClassName = className;
+		mMethodCount = methodCount;
+		mTestCases.clear();
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mMethodName = methodName;
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		OnEndMethod(passed, description, TestTiming());
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		if (passed && mMethodName[0] == '[')
+			return;
+		TestCase testCase;
+		testCase.mName = mMethodName;
+		testCase.mPassed = passed;
+		testCase.mDescription = description;
+		testCase.mSeconds = timing.GetTotal().mWallNanoseconds / 1000000000.0;
+		mTestCases.push_back(testCase);
+		if (!passed && mMethodName == "[InitializeTests]")
+			for (auto index = 1ul; index <= mMethodCount; ++index)
+			{
+				testCase.mName = "[Not run " + std::to_string(index) + "]";
+				testCase.mDescription = "Not run because InitializeTests failed.";
+				testCase.mSeconds = 0;
+				mTestCases.push_back(testCase);
+			}
+	}
+	virtual void OnEndClass()
+	{
+		unsigned long failures = 0;
+		double seconds = 0;
+		for (auto& testCase : mTestCases)
+		{
+			failures += testCase.mPassed ? 0 : 1;
+			seconds += testCase.mSeconds;
+		}
+
+		mOut << "  <testsuite name=\"";
+		WriteEscaped(mClassName);
+		mOut << "\" tests=\"" << static_cast<unsigned long>(mTestCases.size())
+			<< "\" failures=\"" << failures << "\" errors=\"0\" time=\"";
+		mOut.WriteFixed(seconds, 6) << "\">\n";
+		for (auto& testCase : mTestCases)
+			WriteTestCase(testCase);
+		mOut << "  </testsuite>\n";
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		std::string text = message;
+		for (auto position = text.find("--"); position != std::string::npos; position = text.find("--", position))
+			text.replace(position, 2, "- -");
+		mOut << "  <!-- ";
+		WriteEscaped(text);
+		mOut << " -->\n";
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		mOut << "</testsuites>\n";
+		mOut.Flush();
+	}
+
+private:
+	class TestCase
+	{
+	public:
+		std::string mName;
+		bool mPassed;
+		std::string mDescription;
+		double mSeconds;
+	};
+
+	void WriteTestCase(const TestCase& testCase)
+	{
+		mOut << "    <testcase classname=\"";
+		WriteEscaped(mClassName);
+		mOut << "\" name=\"";
+		WriteEscaped(testCase.mName);
+		mOut << "\" time=\"";
+		mOut.WriteFixed(testCase.mSeconds, 6) << "\"";
+		if (testCase.mPassed)
+		{
+			mOut << "/>\n";
+			return;
+		}
+
+		mOut << ">\n      <failure message=\"";
+		WriteEscaped(testCase.mDescription.substr(0, testCase.mDescription.find('\n')));
+		mOut << "\">";
+		WriteEscaped(testCase.mDescription);
+		mOut << "</failure>\n    </testcase>\n";
+	}
+
+	//Escapes text for use in attribute values and element content.  Control characters
+	//that XML 1.0 cannot represent are replaced with U+FFFD.
+	void WriteEscaped(const std::string& text)
+	{
+		for (auto character : text)
+			switch (character)
+			{
+			case '&': mOut << "&amp;"; break;
+			case '<': mOut << "&lt;"; break;
+			case '>': mOut << "&gt;"; break;
+			case '"': mOut << "&quot;"; break;
+			case '\'': mOut << "&apos;"; break;
+			case '\n': mOut << "&#10;"; break;
+			case '\r': mOut << "&#13;"; break;
+			case '\t': mOut << "&#9;"; break;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20)
+					mOut << "&#xFFFD;";
+				else
+					mOut << character;
+			}
+	}
+
+private:
+	TestOutputBuffer mOut;
+	std::string mClassName;
+	std::string mMethodName;
+	unsigned long mMethodCount;
+	std::vector<TestCase> mTestCases;
+};
+
+}
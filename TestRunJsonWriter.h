@@ -0,0 +1,196 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include "ITestRun.h"
+#include "TestTiming.h"
+#include "TestOutputBuffer.h"
+
+namespace UnitTest
+{
+
+// TestRunJsonWriter writes the run as JSON lines, one object per event:
+//
+//	{"event":"begin_run","classes":2,"tests":5}
+//	{"event":"begin_class","class":"FooTest","tests":2}
+//	{"event":"test","class":"FooTest","method":"Func","passed":false,"description":"...",
+//	 "duration_ms":1.250,"begin_ms":0.010,"method_ms":1.230,"end_ms":0.010,"cpu_ms":1.240,
+//	 "allocations":3,"allocated_bytes":96,"peak_live_bytes":64,"leaked_allocations":0}
+//	{"event":"end_class","class":"FooTest"}
+//	{"event":"message","message":"..."}
+//	{"event":"end_run","passed":4,"failed":1}
+//
+// With hardware counters the events of TestHardwareCounts ("cycles", "instructions",
+// "cache_references", "cache_misses", "branches", "branch_misses" and "ipc") are added.
+// Repeated unit tests and benchmarks add their TestRepeatStatistics ("runs", ...) and
+// TestBenchmarkStatistics ("samples", "iterations", "mean_ns", "median_ns", "stddev_ns" and,
+// when compared with a baseline, "baseline_median_ns", "change" and "confidence").
+// InitializeTests and TerminateTests are reported as "test" events with the method
+// names "[InitializeTests]" and "[TerminateTests]".
+class TestRunJsonWriter : public ITestRun
+{
+public:
+	TestRunJsonWriter(std::ostream& out)
+		: mOut(out)
+	{
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mOut << "{\"event\":\"begin_run\",\"classes\":" << classCount << ",\"tests\":" << totalMethodCount << "}\n";
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mClassName = className;
+		mOut << "{\"event\":\"begin_class\",\"class\":";
+		WriteString(mClassName);
+		mOut << ",\"tests\":" << methodCount << "}\n";
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mMethodName = methodName;
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		OnEndMethod(passed, description, TestTiming());
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		auto total = timing.GetTotal();
+		mOut << "{\"event\":\"test\",\"class\":";
+		WriteString(mClassName);
+		mOut << ",\"method\":";
+		WriteString(mMethodName);
+		mOut << ",\"passed\":" << (passed ? "true" : "false") << ",\"description\":";
+		WriteString(description);
+		WriteMilliseconds("duration_ms", total.mWallNanoseconds);
+		WriteMilliseconds("begin_ms", timing.mBeginTest.mWallNanoseconds);
+		WriteMilliseconds("method_ms", timing.mMethod.mWallNanoseconds);
+		WriteMilliseconds("end_ms", timing.mEndTest.mWallNanoseconds);
+		WriteMilliseconds("cpu_ms", total.mCpuNanoseconds);
+		auto& allocations = timing.mAllocations;
+		if (allocations.mCounted)
+		{
+			mOut << ",\"allocations\":" << allocations.mAllocations
+				<< ",\"allocated_bytes\":" << allocations.mAllocatedBytes
+				<< ",\"peak_live_bytes\":" << allocations.mPeakLiveBytes
+				<< ",\"leaked_allocations\":" << allocations.GetLeakedAllocations();
+		}
+		auto& counters = timing.mCounters;
+		if (counters.mMeasured)
+		{
+			mOut << ",\"cycles\":" << counters.mCycles
+				<< ",\"instructions\":" << counters.mInstructions
+				<< ",\"cache_references\":" << counters.mCacheReferences
+				<< ",\"cache_misses\":" << counters.mCacheMisses
+				<< ",\"branches\":" << counters.mBranches
+				<< ",\"branch_misses\":" << counters.mBranchMisses
+				<< ",\"ipc\":";
+			mOut.WriteFixed(counters.GetInstructionsPerCycle(), 3);
+		}
+		auto& repeat = timing.mRepeat;
+		if (repeat.mRuns != 0)
+		{
+			mOut << ",\"runs\":" << repeat.mRuns
+				<< ",\"passed_runs\":" << repeat.mPassedRuns
+				<< ",\"stress_threads\":" << repeat.mThreadCount;
+			WriteMilliseconds("min_ms", repeat.mMinNanoseconds);
+			WriteMilliseconds("median_ms", repeat.mMedianNanoseconds);
+			WriteMilliseconds("p99_ms", repeat.mP99Nanoseconds);
+			WriteMilliseconds("max_ms", repeat.mMaxNanoseconds);
+		}
+		auto& benchmark = timing.mBenchmark;
+		if (benchmark.mSamples != 0)
+		{
+			mOut << ",\"samples\":" << benchmark.mSamples << ",\"iterations\":" << benchmark.mIterations;
+			WriteNanoseconds("mean_ns", benchmark.mMeanNanoseconds);
+			WriteNanoseconds("median_ns", benchmark.mMedianNanoseconds);
+			WriteNanoseconds("stddev_ns", benchmark.mStandardDeviationNanoseconds);
+			if (benchmark.mCompared)
+			{
+				WriteNanoseconds("baseline_median_ns", benchmark.mBaselineMedianNanoseconds);
+				mOut << ",\"change\":";
+				mOut.WriteFixed(benchmark.mChange, 4);
+				mOut << ",\"confidence\":";
+				mOut.WriteFixed(benchmark.mConfidence, 4);
+			}
+		}
+		mOut << "}\n";
+	}
+	virtual void OnEndClass()
+	{
+		mOut << "{\"event\":\"end_class\",\"class\":";
+		WriteString(mClassName);
+		mOut << "}\n";
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mOut << "{\"event\":\"message\",\"message\":";
+		WriteString(message);
+		mOut << "}\n";
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		mOut << "{\"event\":\"end_run\",\"passed\":" << passedCount << ",\"failed\":" << failedCount << "}\n";
+		mOut.Flush();
+	}
+
+	//Writes a "listed" event describing a registered unit test (used to list the unit tests).
+	void WriteListed(const char* className, const char* methodName, const char* location)
+	{
+		mOut << "{\"event\":\"listed\",\"class\":";
+		WriteString(className);
+		mOut << ",\"method\":";
+		WriteString(methodName);
+		mOut << ",\"location\":";
+		WriteString(location);
+		mOut << "}\n";
+	}
+
+	//Writes the buffered events to the stream (otherwise done in large blocks and at OnTerminate).
+	void Flush()
+	{
+		mOut.Flush();
+	}
+
+private:
+	void WriteMilliseconds(const char* name, unsigned long long nanoseconds)
+	{
+		mOut << ",\"" << name << "\":";
+		mOut.WriteFixed(nanoseconds / 1000000.0, 3);
+	}
+
+	void WriteNanoseconds(const char* name, double nanoseconds)
+	{
+		mOut << ",\"" << name << "\":";
+		mOut.WriteFixed(nanoseconds, 3);
+	}
+
+	//Writes text as a JSON string; bytes of multi-byte UTF-8 sequences are passed through.
+	void WriteString(const std::string& text)
+	{
+		static const char digits[] = "0123456789abcdef";
+		mOut << '"';
+		for (auto character : text)
+			switch (character)
+			{
+			case '"': mOut << "\\\""; break;
+			case '\\': mOut << "\\\\"; break;
+			case '\n': mOut << "\\n"; break;
+			case '\r': mOut << "\\r"; break;
+			case '\t': mOut << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(character) < 0x20)
+					mOut << "\\u00" << digits[character >> 4] << digits[character & 0xf];
+				else
+					mOut << character;
+			}
+		mOut << '"';
+	}
+
+private:
+	TestOutputBuffer mOut;
+	std::string mClassName;
+	std::string mMethodName;
+};
+
+}
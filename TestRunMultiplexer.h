@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ITestRun.h"
+#include "TestTiming.h"
+
+namespace UnitTest
+{
+
+// TestRunMultiplexer forwards every ITestRun callback to each added ITestRun in the
+// order they were added, so that several reporters can observe the same run.
+//
+// Example:
+//	TestRunWriter console(std::cout);
+//	TestRunJUnitWriter junit(file);
+//	TestRunMultiplexer multiplexer;
+//	multiplexer.Add(console);
+//	multiplexer.Add(junit);
+//	TestRunner::RunTests(multiplexer);
+class TestRunMultiplexer : public ITestRun
+{
+public:
+	void Add(ITestRun& testRun)
+	{
+		mTestRuns.push_back(&testRun);
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnInitialize(classCount, totalMethodCount);
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnBeginClass(className, methodCount);
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnBeginMethod(methodName);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		OnEndMethod(passed, description, TestTiming());
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnEndMethod(passed, description, timing);
+	}
+	virtual void OnEndClass()
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnEndClass();
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnMessage(message);
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		for (auto testRun : mTestRuns)
+			testRun->OnTerminate(passedCount, failedCount);
+	}
+
+private:
+	std::vector<ITestRun*> mTestRuns;
+};
+
+}
@@ -1,6 +1,11 @@
 #pragma once
 #include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
 #include "ITestRun.h"
+#include "TestTiming.h"
 
 namespace UnitTest
 {
@@ -8,8 +13,9 @@ namespace UnitTest
 class TestRunWriter : public ITestRun
 {
 public:
-	TestRunWriter(std::ostream& out)
-		: mOut(out)
+	//slowestCount is the number of slowest unit tests listed after the run (0 disables the list).
+	TestRunWriter(std::ostream& out, unsigned long slowestCount = 10)
+		: mOut(out), mSlowestCount(slowestCount), mClassName(""), mMethodName("")
 	{
 	}
 
@@ -21,10 +27,12 @@ public:
 	}
 	virtual void OnBeginClass(const char* className, unsigned long methodCount)
 	{
+		mClassName = className;
 		mOut << "TestClass: " << className << ", " << methodCount << " unit test(s)." << std::endl;
 	}
 	virtual void OnBeginMethod(const char* methodName)
 	{
+		mMethodName = methodName;
 		mOut << methodName << "...";
 	}
 	virtual void OnEndMethod(bool passed, const std::string& description)
@@ -33,18 +41,142 @@ public:
 		if (!passed)
 			mOut << description << std::endl;
 	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		//InitializeTests and TerminateTests are reported as "[InitializeTests]" and "[TerminateTests]".
+		if (mSlowestCount > 0 && mMethodName[0] != '[')
+			mTimings.push_back(MethodTiming(mClassName, mMethodName, timing));
+		OnEndMethod(passed, description);
+		if (timing.mRepeat.mRuns != 0)
+			WriteRepeat(timing.mRepeat);
+		if (timing.mBenchmark.mSamples != 0)
+			WriteBenchmark(timing.mBenchmark);
+		if (timing.mCounters.mMeasured)
+			WriteCounters(timing.mCounters, timing.mBenchmark);
+	}
 	virtual void OnEndClass()
 	{
 		mOut << std::endl;
 	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mOut << message << std::endl;
+	}
 	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
 	{
 		mOut << passedCount << " passed, " << failedCount << " failed." << std::endl;
+		WriteSlowest();
+	}
+
+private:
+	class MethodTiming
+	{
+	public:
+		MethodTiming(const char* className, const char* methodName, const TestTiming& timing)
+			: mClassName(className), mMethodName(methodName), mTiming(timing), mTotal(timing.GetTotal())
+		{
+		}
+
+		std::string mClassName;
+		std::string mMethodName;
+		TestTiming mTiming;
+		TestPhaseTiming mTotal;
+	};
+
+	void WriteRepeat(const TestRepeatStatistics& repeat)
+	{
+		auto flags = mOut.flags();
+		auto precision = mOut.precision();
+		mOut << std::fixed << std::setprecision(1)
+			<< "  " << repeat.mRuns << " run(s) on " << repeat.mThreadCount << " thread(s), "
+			<< repeat.GetPassRate() * 100 << "% passed, " << std::setprecision(3)
+			<< "min " << ToMilliseconds(repeat.mMinNanoseconds)
+			<< " ms, median " << ToMilliseconds(repeat.mMedianNanoseconds)
+			<< " ms, p99 " << ToMilliseconds(repeat.mP99Nanoseconds)
+			<< " ms, max " << ToMilliseconds(repeat.mMaxNanoseconds) << " ms" << std::endl;
+		mOut.flags(flags);
+		mOut.precision(precision);
+	}
+
+	void WriteBenchmark(const TestBenchmarkStatistics& benchmark)
+	{
+		auto flags = mOut.flags();
+		auto precision = mOut.precision();
+		mOut << std::fixed << std::setprecision(3)
+			<< "  " << benchmark.mMeanNanoseconds << " ns/iteration, median "
+			<< benchmark.mMedianNanoseconds << " ns, stddev "
+			<< benchmark.mStandardDeviationNanoseconds << " ns ("
+			<< benchmark.mSamples << " sample(s) of " << benchmark.mIterations << " iteration(s))" << std::endl;
+		if (benchmark.mCompared)
+			mOut << "  " << std::showpos << std::setprecision(1) << benchmark.mChange * 100 << std::noshowpos
+				<< "% versus baseline median " << std::setprecision(3) << benchmark.mBaselineMedianNanoseconds
+				<< " ns (" << std::setprecision(1) << benchmark.mConfidence * 100 << "% confidence)" << std::endl;
+		mOut.flags(flags);
+		mOut.precision(precision);
+	}
+
+	//Benchmarks also get the cycles and instructions per iteration of their timed samples.
+	void WriteCounters(const TestHardwareCounts& counters, const TestBenchmarkStatistics& benchmark)
+	{
+		auto flags = mOut.flags();
+		auto precision = mOut.precision();
+		mOut << std::fixed << std::setprecision(2)
+			<< "  " << counters.GetInstructionsPerCycle() << " IPC, "
+			<< counters.GetCacheMissRate() * 100 << "% cache misses, "
+			<< counters.GetBranchMissRate() * 100 << "% branch misses (" << counters.mCycles << " cycles, "
+			<< counters.mInstructions << " instructions";
+		double iterations = benchmark.mSamples * benchmark.mIterations;
+		if (iterations > 0)
+			mOut << "; " << counters.mCycles / iterations << " cycles, "
+				<< counters.mInstructions / iterations << " instructions per iteration";
+		mOut << ")" << std::endl;
+		mOut.flags(flags);
+		mOut.precision(precision);
+	}
+
+	void WriteSlowest()
+	{
+		if (mTimings.empty())
+			return;
+		auto count = std::min<std::size_t>(mSlowestCount, mTimings.size());
+		std::partial_sort(mTimings.begin(), mTimings.begin() + count, mTimings.end(),
+			[](const MethodTiming& lhs, const MethodTiming& rhs)
+			{
+				return lhs.mTotal.mWallNanoseconds > rhs.mTotal.mWallNanoseconds;
+			});
+
+		mOut << std::endl << "Slowest " << count << " unit test(s):" << std::endl;
+		auto flags = mOut.flags();
+		auto precision = mOut.precision();
+		mOut << std::fixed << std::setprecision(3);
+		for (auto index = 0ul; index < count; ++index)
+		{
+			auto& item = mTimings[index];
+			mOut << ToMilliseconds(item.mTotal.mWallNanoseconds) << " ms "
+				<< item.mClassName << "." << item.mMethodName
+				<< " (begin " << ToMilliseconds(item.mTiming.mBeginTest.mWallNanoseconds)
+				<< " ms, method " << ToMilliseconds(item.mTiming.mMethod.mWallNanoseconds)
+				<< " ms, end " << ToMilliseconds(item.mTiming.mEndTest.mWallNanoseconds)
+				<< " ms, cpu " << ToMilliseconds(item.mTotal.mCpuNanoseconds)
+				<< " ms, " << item.mTotal.mVoluntaryContextSwitches + item.mTotal.mInvoluntaryContextSwitches
+				<< " context switch(es))" << std::endl;
+		}
+		mOut.flags(flags);
+		mOut.precision(precision);
+		mTimings.clear();
+	}
+
+	static double ToMilliseconds(unsigned long long nanoseconds)
+	{
+		return nanoseconds / 1000000.0;
 	}
 
 private:
 	std::ostream& mOut;
+	unsigned long mSlowestCount;
+	const char* mClassName;
+	const char* mMethodName;
+	std::vector<MethodTiming> mTimings;
 };
 
 }
-
@@ -1,8 +1,38 @@
 #pragma once
 #include "ITestRun.h"
 #include "TestRepository.h"
+#include "TestRunWriter.h"
+#include "TestRunJUnitWriter.h"
+#include "TestRunJsonWriter.h"
+#include "TestRunMultiplexer.h"
+#include "RunOptions.h"
+#include "TestPlan.h"
+#include "TestIndex.h"
+#include "TestFilter.h"
+#include "TestShard.h"
+#include "TestDurations.h"
+#include "TestHistoryRecorder.h"
+#include "TestFailures.h"
+#include "TestFailureRecorder.h"
+#include "TestBenchmarkRecorder.h"
+#include "TestCoverage.h"
+#include "TestCoverageMap.h"
+#include "TestMethodRunner.h"
+#include "ParallelTestRunner.h"
+#include "IsolatedTestRunner.h"
+#include "TestLibraryHost.h"
+#include "TestServer.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <random>
+#include <chrono>
 
 namespace UnitTest
 {
@@ -12,47 +42,116 @@ class TestRunner
 public:
 	static void RunTests(ITestRun& testRun)
 	{
-		auto& repository = TestRepository::GetInstance();
-		unsigned long classCount = repository.GetCount();
-		unsigned long methodCount = 0;
-		for (unsigned long index = 0; index < classCount; ++index)
-			methodCount += repository.Get(index).GetCount();
-		testRun.OnInitialize(classCount, methodCount);
+		RunTests(testRun, RunOptions());
+	}
 
-		unsigned long passedCount = 0;
-		unsigned long failedCount = 0;
-		for (unsigned long index = 0; index < classCount; ++index)
+	static void RunTests(ITestRun& testRun, const RunOptions& options)
+	{
+		auto run = &testRun;
+		std::unique_ptr<TestHistoryRecorder> history;
+		if (options.mRecordHistory)
 		{
-			auto& factory = repository.Get(index);
-			unsigned long count = factory.GetCount();
-			testRun.OnBeginClass(factory.GetTestClassName(), count);
-
-			if (!InitializeTests(testRun, factory))
-				failedCount += count + 1;
-			else
-				for (unsigned long index = 0; index < count; ++index)
-					if (RunTestMethod(testRun, factory, index))
-						++passedCount;
-					else
-						++failedCount;
-
-			if (!TerminateTests(testRun, factory))
-				++failedCount;
-
-			testRun.OnEndClass();
+			history.reset(new TestHistoryRecorder(*run, options.mDurationsFile, options.mHistoryWindow, options.mRegressionThreshold));
+			run = history.get();
 		}
-
-		testRun.OnTerminate(passedCount, failedCount);
+		std::unique_ptr<TestFailureRecorder> failures;
+		if (options.mRecordFailures || options.mFailedFirst)
+		{
+			failures.reset(new TestFailureRecorder(*run, options.mFailuresFile));
+			run = failures.get();
+		}
+		//Added last so that the failures recorder sees the benchmarks failed for regressing.
+		std::unique_ptr<TestBenchmarkRecorder> benchmarks;
+		if (options.mBenchmarks && (options.mSaveBaseline || options.mCompareBaseline))
+		{
+			benchmarks.reset(new TestBenchmarkRecorder(*run, options.mBaselineFile, options.mSaveBaseline,
+				options.mCompareBaseline, options.mMaxRegression, options.mRegressionConfidence));
+			run = benchmarks.get();
+		}
+		RunPlan(*run, options);
 	}
 
 	static void RunTestsFromCommandLine(int argc, char** argv)
 	{
 		if (argc == 2 && std::strcmp(argv[1], "PrintTests") == 0)
 			PrintTests(std::cout);
+		else if (argc >= 2 && std::strcmp(argv[1], "RunTests") == 0)
+		{
+			RunOptions options;
+			if (ParseRunOptions(argc - 2, argv + 2, options, std::cout))
+				RunTestsWithReports(options, std::cout);
+		}
+		else if (argc >= 2 && std::strcmp(argv[1], "RunBenchmarks") == 0)
+		{
+			RunOptions options;
+			options.mBenchmarks = true;
+			if (ParseRunOptions(argc - 2, argv + 2, options, std::cout))
+				RunTestsWithReports(options, std::cout);
+		}
+		else if (argc >= 4 && std::strcmp(argv[1], "RunShard") == 0)
+		{
+			RunOptions options;
+			options.mShardIndex = std::strtoul(argv[2], nullptr, 10);
+			options.mShardCount = std::strtoul(argv[3], nullptr, 10);
+			if (options.mShardCount == 0 || options.mShardIndex >= options.mShardCount)
+				std::cout << "Failed: invalid shard " << argv[2] << " of " << argv[3] << "." << std::endl;
+			else if (ParseRunOptions(argc - 4, argv + 4, options, std::cout))
+				RunTestsWithReports(options, std::cout);
+		}
+		else if (argc >= 2 && std::strcmp(argv[1], "RunImpacted") == 0)
+		{
+			RunOptions options;
+			if (ParseImpactedOptions(argc - 2, argv + 2, options, std::cin, std::cout))
+				RunTestsWithReports(options, std::cout);
+		}
+#if !defined(_WIN32)
+		else if (argc >= 3 && std::strcmp(argv[1], "Host") == 0)
+			RunHost(argc - 2, argv + 2, std::cin, std::cout);
+		else if (argc >= 3 && std::strcmp(argv[1], "Serve") == 0)
+			Serve(argv[2], argc - 3, argv + 3, std::cout);
+#endif
 		else if (argc == 4 && std::strcmp(argv[1], "RunSingleTest") == 0)
 			RunSingleTest(argv[2], argv[3], std::cout);
 	}
 
+	//Runs the unit tests with TestRunWriter output plus the report files named in options.
+	static void RunTestsWithReports(const RunOptions& options, std::ostream& out)
+	{
+		TestRunWriter writer{ out };
+		TestRunMultiplexer multiplexer;
+		multiplexer.Add(writer);
+
+		std::ofstream junitFile;
+		std::unique_ptr<TestRunJUnitWriter> junit;
+		if (!options.mJUnitFile.empty())
+		{
+			junitFile.open(options.mJUnitFile.c_str());
+			if (!junitFile)
+			{
+				out << "Failed: unable to open " << options.mJUnitFile << "." << std::endl;
+				return;
+			}
+			junit.reset(new TestRunJUnitWriter(junitFile));
+			multiplexer.Add(*junit);
+		}
+
+		std::ofstream jsonFile;
+		std::unique_ptr<TestRunJsonWriter> json;
+		if (!options.mJsonFile.empty())
+		{
+			jsonFile.open(options.mJsonFile.c_str());
+			if (!jsonFile)
+			{
+				out << "Failed: unable to open " << options.mJsonFile << "." << std::endl;
+				return;
+			}
+			json.reset(new TestRunJsonWriter(jsonFile));
+			multiplexer.Add(*json);
+		}
+
+		RunTests(multiplexer, options);
+	}
+
 	static void PrintTests(std::ostream& out)
 	{
 		auto& repository = TestRepository::GetInstance();
@@ -73,37 +172,22 @@ public:
 	{
 		try
 		{
-			auto& repository = TestRepository::GetInstance();
-			auto foundClass = false;
-			for (auto classIndex = 0ul; !foundClass && classIndex < repository.GetCount(); ++classIndex)
+			auto& index = TestIndex::GetInstance();
+			auto entry = index.FindMethod(className, testMethodName);
+			if (entry != nullptr)
 			{
-				auto& classFactory = repository.Get(classIndex);
-				if (className == classFactory.GetTestClassName())
-				{
-					foundClass = true;
-					auto foundMethod = false;
-					for (auto methodIndex = 0ul; !foundMethod && methodIndex < classFactory.GetCount(); ++methodIndex)
-					{
-						auto& methodFactory = classFactory.Get(methodIndex);
-						if (testMethodName == methodFactory.GetTestMethodName())
-						{
-							foundMethod = true;
-							classFactory.InitializeTests();
-							auto instance = classFactory.CreateInstance();
-							instance->BeginTest();
-							methodFactory.CreateInstance(instance.get())->Execute();
-							instance->EndTest();
-							classFactory.TerminateTests();
-							out << "Success" << std::endl;
-						}
-					}
-
-					if (!foundMethod)
-						out << "Failed: " << testMethodName << " unit test not found in " << className << " test class." << std::endl;
-				}
+				auto& classFactory = *entry->mFactory;
+				classFactory.InitializeTests();
+				auto instance = classFactory.CreateInstance();
+				instance->BeginTest();
+				classFactory.Get(entry->mMethodIndex).Execute(*instance);
+				instance->EndTest();
+				classFactory.TerminateTests();
+				out << "Success" << std::endl;
 			}
-
-			if (!foundClass)
+			else if (index.FindClass(className) != nullptr)
+				out << "Failed: " << testMethodName << " unit test not found in " << className << " test class." << std::endl;
+			else
 				out << "Failed: " << className << " test class not found." << std::endl;
 		}
 		catch (const std::exception& error)
@@ -116,83 +200,469 @@ public:
 		}
 	}
 
-private:
-	static bool InitializeTests(ITestRun& testRun, ITestClassFactory& factory)
+	//Parses "--name=value" options following the RunTests and RunShard commands.
+	static bool ParseRunOptions(int argc, char** argv, RunOptions& options, std::ostream& out)
 	{
-		bool success = false;
-		std::string reason;
-		testRun.OnBeginMethod("[InitializeTests]");
-		try
+		std::string error;
+		for (auto index = 0; index < argc; ++index)
 		{
-			factory.InitializeTests();
-			success = true;
+			std::string argument = argv[index];
+			auto separator = argument.find('=');
+			auto name = argument.substr(0, separator);
+			auto value = separator == std::string::npos ? std::string() : argument.substr(separator + 1);
+			if (name == "--threads")
+				options.mThreadCount = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--isolate")
+				options.mIsolateProcesses = true;
+			else if ((name == "--include" || name == "--exclude") && !TestFilter::IsValid(value, error))
+			{
+				out << "Failed: invalid pattern " << value << " (" << error << ")." << std::endl;
+				return false;
+			}
+			else if (name == "--include")
+				options.mIncludes.push_back(value);
+			else if (name == "--exclude")
+				options.mExcludes.push_back(value);
+			else if (name == "--durations")
+				options.mDurationsFile = value;
+			else if (name == "--history")
+				options.mRecordHistory = true;
+			else if (name == "--history-window")
+				options.mHistoryWindow = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--regression-threshold")
+				options.mRegressionThreshold = std::strtod(value.c_str(), nullptr);
+			else if (name == "--failures")
+				options.mFailuresFile = value;
+			else if (name == "--record-failures")
+				options.mRecordFailures = true;
+			else if (name == "--failed-first")
+				options.mFailedFirst = true;
+			else if (name == "--fail-fast")
+				options.mFailFast = value.empty() ? 1 : std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--junit")
+				options.mJUnitFile = value;
+			else if (name == "--json")
+				options.mJsonFile = value;
+			else if (name == "--allocations")
+				options.mAllocations = TestAllocations::Count;
+			else if (name == "--leaks")
+				options.mAllocations = TestAllocations::FailOnLeaks;
+			else if (name == "--counters")
+				options.mHardwareCounters = true;
+			else if (name == "--coverage")
+				options.mCoverageFile = value;
+			else if (name == "--coverage-directory")
+				options.mCoverageDirectory = value;
+			else if (name == "--record-coverage")
+				options.mRecordCoverage = true;
+			else if (name == "--repeat")
+				options.mRepeatCount = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--stress")
+				options.mStressThreads = value.empty() ? std::thread::hardware_concurrency() : std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--shuffle")
+			{
+				options.mShuffle = true;
+				options.mShuffleSeed = std::strtoull(value.c_str(), nullptr, 10);
+			}
+			else if (name == "--samples")
+				options.mBenchmarkSamples = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--sample-time")
+				options.mBenchmarkSampleMilliseconds = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--warmup")
+				options.mBenchmarkWarmupMilliseconds = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--baseline")
+				options.mBaselineFile = value;
+			else if (name == "--save-baseline")
+				options.mSaveBaseline = true;
+			else if (name == "--compare")
+				options.mCompareBaseline = true;
+			else if (name == "--max-regression")
+				options.mMaxRegression = std::strtod(value.c_str(), nullptr) / 100;
+			else if (name == "--confidence")
+				options.mRegressionConfidence = std::strtod(value.c_str(), nullptr) / 100;
+			else if (name == "--timeout")
+				options.mTimeoutMilliseconds = std::strtoul(value.c_str(), nullptr, 10);
+			else
+			{
+				out << "Failed: unknown option " << argument << "." << std::endl;
+				return false;
+			}
 		}
-		catch (const std::exception& error)
+		return true;
+	}
+
+#if !defined(_WIN32)
+	//Loads the test libraries named in argv (see TestLibraryHost) and runs the unit tests with
+	//the options in argv; then reruns them, after reloading the libraries that changed, for
+	//every line read from in until "q" or the end of input.
+	static void RunHost(int argc, char** argv, std::istream& in, std::ostream& out)
+	{
+		std::vector<char*> arguments;
+		std::vector<std::string> libraries;
+		for (auto index = 0; index < argc; ++index)
+			if (std::strncmp(argv[index], "--", 2) == 0)
+				arguments.push_back(argv[index]);
+			else
+				libraries.push_back(argv[index]);
+		RunOptions options;
+		if (!ParseRunOptions(static_cast<int>(arguments.size()), arguments.data(), options, out))
+			return;
+
+		TestLibraryHost host;
+		std::string error;
+		for (auto& library : libraries)
+			if (!host.Load(library, error))
+				out << "Failed: " << error << std::endl;
+		for (;;)
 		{
-			reason = error.what();
+			RunTestsWithReports(options, out);
+			out << "Press Enter to reload changed libraries and rerun the unit tests, or q to quit." << std::endl;
+			std::string line;
+			if (!std::getline(in, line) || line == "q")
+				break;
+			std::vector<std::string> reloaded;
+			if (!host.ReloadChanged(reloaded, error))
+				out << "Failed: " << error << std::endl;
+			for (auto& library : reloaded)
+				out << "Reloaded " << library << "." << std::endl;
 		}
-		catch (...)
+	}
+
+	//Serves list, run, reload, quit and shutdown requests on the Unix domain socket path (see
+	//TestServerSocket) until a shutdown request.  argv names test libraries to load (see
+	//TestLibraryHost) and default options for every run.  Test classes stay initialized
+	//between requests and the response to each request ends with an empty frame.
+	static void Serve(const std::string& path, int argc, char** argv, std::ostream& out)
+	{
+		std::vector<char*> arguments;
+		std::vector<std::string> libraries;
+		for (auto index = 0; index < argc; ++index)
+			if (std::strncmp(argv[index], "--", 2) == 0)
+				arguments.push_back(argv[index]);
+			else
+				libraries.push_back(argv[index]);
+		RunOptions defaults;
+		if (!ParseRunOptions(static_cast<int>(arguments.size()), arguments.data(), defaults, out))
+			return;
+
+		TestLibraryHost host;
+		TestServerSocket socket;
+		std::string error;
+		for (auto& library : libraries)
+			if (!host.Load(library, error))
+				out << "Failed: " << error << std::endl;
+		if (!socket.Listen(path, error))
+		{
+			out << "Failed: " << error << std::endl;
+			return;
+		}
+		out << "Listening on " << path << "." << std::endl;
+
+		auto stopping = false;
+		while (!stopping && socket.Accept())
 		{
-			reason = "Unhandled exception.";
+			std::string request;
+			while (!stopping && socket.Read(request))
+			{
+				std::istringstream words(request);
+				std::string command;
+				words >> command;
+				if (command == "quit")
+					break;
+				stopping = command == "shutdown";
+
+				TestRunFrameWriter writer(socket);
+				if (command == "list")
+					ListTests(writer);
+				else if (command == "run")
+				{
+					std::vector<std::string> options;
+					std::string option;
+					while (words >> option)
+						options.push_back(option);
+					ServeRun(writer, defaults, options);
+				}
+				else if (command == "reload")
+				{
+					std::vector<std::string> reloaded;
+					if (!host.ReloadChanged(reloaded, error))
+						writer.OnMessage("Failed: " + error);
+					for (auto& library : reloaded)
+						writer.OnMessage("Reloaded " + library + ".");
+				}
+				else if (!stopping)
+					writer.OnMessage("Failed: unknown request " + command + ".");
+				if (!writer.IsConnected() || !socket.Write(std::string()))
+					break;
+			}
 		}
-		testRun.OnEndMethod(success, reason);
-		return success;
 	}
+#endif
 
-	static bool TerminateTests(ITestRun& testRun, ITestClassFactory& factory)
+	//Parses the options and changed files following the RunImpacted command; a "-" argument
+	//reads further changed files from in, one per line.
+	static bool ParseImpactedOptions(int argc, char** argv, RunOptions& options, std::istream& in, std::ostream& out)
 	{
-		bool success = false;
-		std::string reason;
-		testRun.OnBeginMethod("[TerminateTests]");
-		try
+		std::vector<char*> arguments;
+		options.mImpactedOnly = true;
+		for (auto index = 0; index < argc; ++index)
+			if (std::strncmp(argv[index], "--", 2) == 0)
+				arguments.push_back(argv[index]);
+			else if (std::strcmp(argv[index], "-") != 0)
+				options.mChangedFiles.push_back(argv[index]);
+			else
+			{
+				std::string line;
+				while (std::getline(in, line))
+					if (!line.empty())
+						options.mChangedFiles.push_back(line);
+			}
+		return ParseRunOptions(static_cast<int>(arguments.size()), arguments.data(), options, out);
+	}
+
+private:
+	// CoverageRecording holds the coverage collected while mRecordCoverage is set.
+	class CoverageRecording
+	{
+	public:
+		CoverageRecording(const RunOptions& options)
+			: mCoverage(options.mCoverageDirectory), mFileName(options.mCoverageFile)
 		{
-			factory.TerminateTests();
-			success = true;
+			mMap.Load(mFileName);
 		}
-		catch (const std::exception& error)
+
+		~CoverageRecording()
 		{
-			reason = error.what();
+			mMap.Save(mFileName);
 		}
-		catch (...)
+
+		TestCoverage mCoverage;
+		TestCoverageMap mMap;
+		std::string mFileName;
+	};
+
+#if !defined(_WIN32)
+	static void ListTests(TestRunFrameWriter& writer)
+	{
+		for (auto& entry : TestIndex::GetInstance().GetEntries())
 		{
-			reason = "Unhandled exception.";
+			auto& methodFactory = entry.mFactory->Get(entry.mMethodIndex);
+			writer.WriteListed(entry.mFactory->GetTestClassName(), methodFactory.GetTestMethodName(), methodFactory.GetTestMethodLocation());
 		}
-		testRun.OnEndMethod(success, reason);
-		return success;
 	}
 
-	static bool RunTestMethod(ITestRun& testRun, ITestClassFactory& factory, unsigned long index)
+	static void ServeRun(TestRunFrameWriter& writer, const RunOptions& defaults, std::vector<std::string>& arguments)
 	{
-		bool success = false;
-		std::string reason;
-		auto& mfactory = factory.Get(index);
-		testRun.OnBeginMethod(mfactory.GetTestMethodName());
-		try
+		std::vector<char*> pointers;
+		for (auto& argument : arguments)
+			pointers.push_back(&argument[0]);
+		auto options = defaults;
+		std::ostringstream errors;
+		if (ParseRunOptions(static_cast<int>(pointers.size()), pointers.data(), options, errors))
+			RunTests(writer, options);
+		else
+			writer.OnMessage(errors.str().substr(0, errors.str().find('\n')));
+	}
+#endif
+
+	static void RunPlan(ITestRun& testRun, const RunOptions& requestedOptions)
+	{
+		auto options = requestedOptions;
+		//Reported once the run is initialized, so that writers start their output first.
+		std::vector<std::string> messages;
+		if (options.mAllocations != TestAllocations::Off && !TestAllocations::IsInstalled())
 		{
-			auto instance = factory.CreateInstance();
-			try
-			{
-				instance->BeginTest();
-				mfactory.CreateInstance(instance.get())->Execute();
-			}
-			catch (...)
-			{
-				instance->EndTest();
-				throw;
-			}
-			instance->EndTest();
-			success = true;
+			messages.push_back("Warning: allocations are not counted since UNIT_TEST_ALLOCATION_TRACKING() is not used.");
+			options.mAllocations = TestAllocations::Off;
 		}
-		catch (const std::exception& error)
+		std::string error;
+		if (options.mHardwareCounters && !TestHardwareCounters::IsAvailable(error))
 		{
-			reason = error.what();
+			messages.push_back("Warning: hardware counters are not counted since " + error + ".");
+			options.mHardwareCounters = false;
 		}
-		catch (...)
+		std::unique_ptr<CoverageRecording> coverage;
+		if (options.mRecordCoverage && !TestCoverage::IsAvailable())
+			messages.push_back("Warning: coverage is not recorded since UNIT_TEST_COVERAGE() is not used.");
+		else if (options.mRecordCoverage)
+		{
+			//The gcov counters are process wide, so only one unit test may run at a time.
+			coverage.reset(new CoverageRecording(options));
+			options.mThreadCount = 1;
+			options.mIsolateProcesses = false;
+		}
+		if (options.mBenchmarks)
+		{
+			options.mThreadCount = 1;
+			options.mIsolateProcesses = false;
+			options.mAllocations = TestAllocations::Off;
+		}
+
+		auto plan = CreatePlan(options);
+		plan.Filter([&](const ITestClassFactory& factory, unsigned long index)
+		{
+			return factory.Get(index).IsBenchmark() == options.mBenchmarks;
+		});
+		if (options.mImpactedOnly)
+		{
+			TestCoverageMap map;
+			map.Load(options.mCoverageFile);
+			map.SelectImpacted(plan, options.mChangedFiles);
+		}
+		if (options.mShardCount > 1)
+		{
+			TestDurations durations;
+			durations.Load(options.mDurationsFile);
+			TestShard::Select(plan, options.mShardIndex, options.mShardCount, durations);
+		}
+		if (options.mShuffle)
 		{
-			reason = "Unhandled exception.";
+			auto seed = options.mShuffleSeed == 0 ? CreateSeed() : options.mShuffleSeed;
+			messages.push_back("Shuffled with seed " + std::to_string(seed) + " (replay with --shuffle=" + std::to_string(seed) + ").");
+			plan.Shuffle(seed);
 		}
-		testRun.OnEndMethod(success, reason);
-		return success;
+		if (options.mFailedFirst)
+		{
+			TestFailures failures;
+			failures.Load(options.mFailuresFile);
+			failures.Prioritize(plan);
+		}
+		testRun.OnInitialize(plan.GetCount(), plan.GetMethodCount());
+		for (auto& message : messages)
+			testRun.OnMessage(message);
+
+		unsigned long passedCount = 0;
+		unsigned long failedCount = 0;
+		auto threadCount = options.mThreadCount;
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency();
+		//Timeouts need a watchdog and abandonable worker threads, even for a single thread.
+		if (!options.mIsolateProcesses && !coverage && !options.mBenchmarks && (threadCount > 1 || HasTimeout(plan, options.mTimeoutMilliseconds)))
+			ParallelTestRunner::Run(testRun, plan, options, threadCount, passedCount, failedCount);
+		else
+			for (auto index = 0ul; index < plan.GetCount() && !IsStopped(options, failedCount); ++index)
+				RunTestClass(testRun, plan.Get(index), options, threadCount, coverage.get(), passedCount, failedCount);
+
+		if (IsStopped(options, failedCount))
+			testRun.OnMessage("Fail-fast limit of " + std::to_string(options.mFailFast) + " failure(s) reached; unit tests not yet started were skipped.");
+
+		testRun.OnTerminate(passedCount, failedCount);
+	}
+
+	static unsigned long long CreateSeed()
+	{
+		std::random_device device;
+		auto seed = (static_cast<unsigned long long>(device()) << 32) ^ device()
+			^ static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count());
+		return seed == 0 ? 1 : seed;
+	}
+
+	static bool IsStopped(const RunOptions& options, unsigned long failedCount)
+	{
+		return options.mFailFast != 0 && failedCount >= options.mFailFast;
+	}
+
+	static bool HasTimeout(const TestPlan& plan, unsigned long defaultTimeout)
+	{
+		for (auto index = 0ul; index < plan.GetCount(); ++index)
+		{
+			auto& entry = plan.Get(index);
+			for (auto method : entry.mMethods)
+				if (TestMethodRunner::GetTimeout(*entry.mFactory, method, defaultTimeout) != 0)
+					return true;
+		}
+		return false;
+	}
+
+	static TestPlan CreatePlan(const RunOptions& options)
+	{
+		if (options.mIncludes.empty() && options.mExcludes.empty())
+			return TestPlan::FromRepository();
+		TestFilter filter;
+		for (auto& pattern : options.mIncludes)
+			filter.Include(pattern);
+		for (auto& pattern : options.mExcludes)
+			filter.Exclude(pattern);
+		return filter.CreatePlan(TestIndex::GetInstance());
+	}
+
+	static void RunTestClass(
+		ITestRun& testRun,
+		const TestPlanClass& entry,
+		const RunOptions& options,
+		unsigned long threadCount,
+		CoverageRecording* coverage,
+		unsigned long& passedCount,
+		unsigned long& failedCount)
+	{
+		auto& factory = *entry.mFactory;
+		std::string className = factory.GetTestClassName();
+		unsigned long count = entry.mMethods.size();
+		testRun.OnBeginClass(factory.GetTestClassName(), count);
+
+		//The class entry gets the files executed by InitializeTests and TerminateTests.
+		std::set<std::string> classFiles;
+		testRun.OnBeginMethod("[InitializeTests]");
+		if (coverage != nullptr)
+			coverage->mCoverage.Begin();
+		auto initialized = TestMethodRunner::InitializeTests(factory);
+		if (coverage != nullptr)
+			classFiles = coverage->mCoverage.Collect();
+		if (!EndMethod(testRun, initialized))
+			failedCount += count + 1;
+#if !defined(_WIN32)
+		else if (options.mIsolateProcesses)
+			IsolatedTestRunner::RunTestMethods(
+				testRun,
+				entry,
+				threadCount,
+				options,
+				options.mFailFast == 0 ? 0 : options.mFailFast - failedCount,
+				passedCount,
+				failedCount);
+#endif
+		else
+			for (auto index : entry.mMethods)
+			{
+				if (IsStopped(options, failedCount))
+					break;
+				auto methodName = factory.Get(index).GetTestMethodName();
+				testRun.OnBeginMethod(methodName);
+				if (coverage != nullptr)
+					coverage->mCoverage.Begin();
+				auto result = options.mBenchmarks
+					? TestMethodRunner::RunBenchmarkMethod(factory, index, options.mBenchmarkSamples,
+						options.mBenchmarkSampleMilliseconds, options.mBenchmarkWarmupMilliseconds, options.mHardwareCounters)
+					: TestMethodRunner::RunTestMethod(factory, index, options.mAllocations, options.mHardwareCounters,
+						options.mRepeatCount, options.mStressThreads);
+				if (coverage != nullptr)
+					coverage->mMap.Set(className + "." + methodName, coverage->mCoverage.Collect());
+				if (EndMethod(testRun, result))
+					++passedCount;
+				else
+					++failedCount;
+			}
+
+		testRun.OnBeginMethod("[TerminateTests]");
+		if (coverage != nullptr)
+			coverage->mCoverage.Begin();
+		auto terminated = TestMethodRunner::TerminateTests(factory);
+		if (coverage != nullptr)
+		{
+			auto files = coverage->mCoverage.Collect();
+			classFiles.insert(files.begin(), files.end());
+			coverage->mMap.Set(className, classFiles);
+		}
+		if (!EndMethod(testRun, terminated))
+			++failedCount;
+
+		testRun.OnEndClass();
+	}
+
+	static bool EndMethod(ITestRun& testRun, const TestResult& result)
+	{
+		testRun.OnEndMethod(result.GetPassed(), result.GetDescription(), result.GetTiming());
+		return result.GetPassed();
 	}
 };
 
@@ -0,0 +1,245 @@
+#pragma once
+#if !defined(_WIN32)
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ITestRun.h"
+#include "TestRunJsonWriter.h"
+
+namespace UnitTest
+{
+
+// TestServerSocket is the listening Unix domain socket of the Serve command and the
+// connection of its current client.  Requests and responses are frames: a 4 byte
+// big-endian payload length followed by the payload.  A request payload is a command
+// line ("list", "run --include=FooTest.Func", "reload", "quit" or "shutdown") and each
+// response payload is one JSON lines event (see TestRunJsonWriter).
+class TestServerSocket
+{
+public:
+	static const std::uint32_t MaxFrameSize = 1024 * 1024;
+
+	TestServerSocket()
+		: mListener(-1), mConnection(-1)
+	{
+	}
+
+	~TestServerSocket()
+	{
+		Disconnect();
+		if (mListener >= 0)
+		{
+			::close(mListener);
+			::unlink(mPath.c_str());
+		}
+	}
+
+	TestServerSocket(const TestServerSocket& rhs) = delete;
+	TestServerSocket& operator=(const TestServerSocket& rhs) = delete;
+
+	//Replaces any existing socket file at path.
+	bool Listen(const std::string& path, std::string& error)
+	{
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			error = "socket path " + path + " is too long.";
+			return false;
+		}
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		mListener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		::unlink(path.c_str());
+		if (mListener < 0 ||
+			::bind(mListener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+			::listen(mListener, 4) != 0)
+		{
+			error = "unable to listen on " + path + ": " + std::strerror(errno) + ".";
+			return false;
+		}
+		mPath = path;
+		return true;
+	}
+
+	//Waits for the next client, closing the current one.
+	bool Accept()
+	{
+		Disconnect();
+		for (;;)
+		{
+			mConnection = ::accept(mListener, nullptr, nullptr);
+			if (mConnection >= 0)
+				return true;
+			if (errno != EINTR)
+				return false;
+		}
+	}
+
+	void Disconnect()
+	{
+		if (mConnection >= 0)
+			::close(mConnection);
+		mConnection = -1;
+	}
+
+	//Returns false when the client disconnected or sent an invalid frame.
+	bool Read(std::string& payload)
+	{
+		unsigned char header[4];
+		if (!ReadAll(header, sizeof(header)))
+			return false;
+		std::uint32_t size = static_cast<std::uint32_t>(header[0]) << 24 | header[1] << 16 | header[2] << 8 | header[3];
+		if (size > MaxFrameSize)
+			return false;
+		payload.assign(size, '\0');
+		return size == 0 || ReadAll(&payload[0], size);
+	}
+
+	bool Write(const std::string& payload)
+	{
+		std::uint32_t size = payload.size();
+		unsigned char header[4] = {
+			static_cast<unsigned char>(size >> 24),
+			static_cast<unsigned char>(size >> 16),
+			static_cast<unsigned char>(size >> 8),
+			static_cast<unsigned char>(size) };
+		return WriteAll(header, sizeof(header)) && WriteAll(payload.data(), payload.size());
+	}
+
+private:
+	bool ReadAll(void* buffer, std::size_t size)
+	{
+		auto data = static_cast<char*>(buffer);
+		while (size > 0)
+		{
+			auto count = ::recv(mConnection, data, size, 0);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			data += count;
+			size -= count;
+		}
+		return true;
+	}
+
+	bool WriteAll(const void* buffer, std::size_t size)
+	{
+#if defined(MSG_NOSIGNAL)
+		//A client that went away must not kill the server with SIGPIPE.
+		const int flags = MSG_NOSIGNAL;
+#else
+		const int flags = 0;
+#endif
+		auto data = static_cast<const char*>(buffer);
+		while (size > 0)
+		{
+			auto count = ::send(mConnection, data, size, flags);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			data += count;
+			size -= count;
+		}
+		return true;
+	}
+
+private:
+	std::string mPath;
+	int mListener;
+	int mConnection;
+};
+
+// TestRunFrameWriter sends every ITestRun event to the client of a TestServerSocket as
+// soon as it happens, one JSON lines event per frame.  Events are dropped once the
+// client has gone away.
+class TestRunFrameWriter : public ITestRun
+{
+public:
+	TestRunFrameWriter(TestServerSocket& socket)
+		: mSocket(socket), mWriter(mEvents), mConnected(true)
+	{
+	}
+
+	virtual void OnInitialize(unsigned long classCount, unsigned long totalMethodCount)
+	{
+		mWriter.OnInitialize(classCount, totalMethodCount);
+		Send();
+	}
+	virtual void OnBeginClass(const char* className, unsigned long methodCount)
+	{
+		mWriter.OnBeginClass(className, methodCount);
+		Send();
+	}
+	virtual void OnBeginMethod(const char* methodName)
+	{
+		mWriter.OnBeginMethod(methodName);
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description)
+	{
+		OnEndMethod(passed, description, TestTiming());
+	}
+	virtual void OnEndMethod(bool passed, const std::string& description, const TestTiming& timing)
+	{
+		mWriter.OnEndMethod(passed, description, timing);
+		Send();
+	}
+	virtual void OnEndClass()
+	{
+		mWriter.OnEndClass();
+		Send();
+	}
+	virtual void OnMessage(const std::string& message)
+	{
+		mWriter.OnMessage(message);
+		Send();
+	}
+	virtual void OnTerminate(unsigned long passedCount, unsigned long failedCount)
+	{
+		mWriter.OnTerminate(passedCount, failedCount);
+		Send();
+	}
+
+	void WriteListed(const char* className, const char* methodName, const char* location)
+	{
+		mWriter.WriteListed(className, methodName, location);
+		Send();
+	}
+
+	bool IsConnected() const
+	{
+		return mConnected;
+	}
+
+private:
+	void Send()
+	{
+		mWriter.Flush();
+		auto events = mEvents.str();
+		mEvents.str(std::string());
+		for (std::string::size_type begin = 0, end = 0; mConnected && begin < events.size(); begin = end + 1)
+		{
+			end = events.find('\n', begin);
+			if (end == std::string::npos)
+				end = events.size();
+			mConnected = mSocket.Write(events.substr(begin, end - begin));
+		}
+	}
+
+private:
+	TestServerSocket& mSocket;
+	std::ostringstream mEvents;
+	TestRunJsonWriter mWriter;
+	bool mConnected;
+};
+
+}
+#endif
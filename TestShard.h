@@ -0,0 +1,126 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <cstdint>
+#include "TestPlan.h"
+#include "TestDurations.h"
+
+namespace UnitTest
+{
+
+// TestShard deterministically partitions a TestPlan into shardCount shards so that
+// several processes (or machines) can each run one shard of the same test binary.
+// When recorded durations are available the unit tests are assigned using
+// longest-processing-time-first bin packing (unit tests without a recorded duration
+// are assumed to take the mean recorded duration).  Otherwise each unit test is
+// assigned by a stable hash of its "ClassName.MethodName" key.
+class TestShard
+{
+public:
+	static void Select(TestPlan& plan, unsigned long shardIndex, unsigned long shardCount, const TestDurations& durations)
+	{
+		if (shardCount <= 1)
+			return;
+		auto selected = durations.IsEmpty() ?
+			SelectByHash(plan, shardIndex, shardCount) :
+			SelectByDuration(plan, shardIndex, shardCount, durations);
+		plan.Filter([&](const ITestClassFactory& factory, unsigned long index)
+		{
+			return selected.count(GetKey(factory, index)) != 0;
+		});
+	}
+
+	//64-bit FNV-1a, used because std::hash is not guaranteed to be stable between builds.
+	static std::uint64_t StableHash(const std::string& value)
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		for (auto character : value)
+		{
+			hash ^= static_cast<unsigned char>(character);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+private:
+	class Job
+	{
+	public:
+		std::string mKey;
+		double mDuration;
+	};
+
+	static std::string GetKey(const ITestClassFactory& factory, unsigned long index)
+	{
+		return TestDurations::GetKey(factory.GetTestClassName(), factory.Get(index).GetTestMethodName());
+	}
+
+	static std::unordered_set<std::string> SelectByHash(const TestPlan& plan, unsigned long shardIndex, unsigned long shardCount)
+	{
+		std::unordered_set<std::string> selected;
+		for (auto classIndex = 0ul; classIndex < plan.GetCount(); ++classIndex)
+		{
+			auto& entry = plan.Get(classIndex);
+			for (auto index : entry.mMethods)
+			{
+				auto key = GetKey(*entry.mFactory, index);
+				if (StableHash(key) % shardCount == shardIndex)
+					selected.insert(key);
+			}
+		}
+		return selected;
+	}
+
+	static std::unordered_set<std::string> SelectByDuration(
+		const TestPlan& plan,
+		unsigned long shardIndex,
+		unsigned long shardCount,
+		const TestDurations& durations)
+	{
+		std::vector<Job> jobs;
+		double knownTotal = 0;
+		unsigned long knownCount = 0;
+		for (auto classIndex = 0ul; classIndex < plan.GetCount(); ++classIndex)
+		{
+			auto& entry = plan.Get(classIndex);
+			for (auto index : entry.mMethods)
+			{
+				Job job;
+				job.mKey = GetKey(*entry.mFactory, index);
+				job.mDuration = durations.GetExpected(job.mKey);
+				if (job.mDuration >= 0)
+				{
+					knownTotal += job.mDuration;
+					++knownCount;
+				}
+				jobs.push_back(job);
+			}
+		}
+
+		auto unknownDuration = knownCount == 0 ? 1.0 : knownTotal / knownCount;
+		for (auto& job : jobs)
+			if (job.mDuration < 0)
+				job.mDuration = unknownDuration;
+
+		//Ties are broken by key so that every shard process computes the same assignment.
+		std::sort(jobs.begin(), jobs.end(), [](const Job& lhs, const Job& rhs)
+		{
+			return lhs.mDuration != rhs.mDuration ? lhs.mDuration > rhs.mDuration : lhs.mKey < rhs.mKey;
+		});
+
+		std::vector<double> loads(shardCount, 0.0);
+		std::unordered_set<std::string> selected;
+		for (auto& job : jobs)
+		{
+			auto shard = std::min_element(loads.begin(), loads.end()) - loads.begin();
+			loads[shard] += job.mDuration;
+			if (static_cast<unsigned long>(shard) == shardIndex)
+				selected.insert(job.mKey);
+		}
+		return selected;
+	}
+};
+
+}
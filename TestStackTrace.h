@@ -0,0 +1,180 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace UnitTest
+{
+
+// TestStackTrace captures the call stack of another (possibly hung) thread of this
+// process by signalling it with SIGUSR2; the signal handler records the stack with
+// backtrace().  Stack traces are only available with glibc and on macOS (link with
+// -rdynamic to get function names); elsewhere Capture returns an empty string.
+//
+// In a forked test worker the handler can instead write the raw frames to a pipe
+// (see SetFrameDescriptor) so that the parent process can report the stack of a
+// worker it is about to kill.  The frame is a 0xffffffff marker, the frame count
+// and the frame addresses, each in native byte order.
+class TestStackTrace
+{
+public:
+	static const int MaxFrames = 64;
+	static const unsigned int FrameMarker = 0xffffffffu;
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+	typedef pthread_t ThreadHandle;
+
+	static ThreadHandle GetCurrentThread()
+	{
+		return ::pthread_self();
+	}
+
+	static int GetSignal()
+	{
+		return SIGUSR2;
+	}
+
+	static void Install()
+	{
+		static std::once_flag once;
+		std::call_once(once, []()
+		{
+			//The first call to backtrace may allocate, so it must not happen in the handler.
+			void* frames[1];
+			::backtrace(frames, 1);
+			GetSlot();
+			struct sigaction action;
+			std::memset(&action, 0, sizeof(action));
+			action.sa_handler = &OnSignal;
+			sigemptyset(&action.sa_mask);
+			action.sa_flags = SA_RESTART;
+			::sigaction(GetSignal(), &action, nullptr);
+		});
+	}
+
+	//Returns the formatted call stack of thread or an empty string if it did not respond.
+	static std::string Capture(ThreadHandle thread)
+	{
+		Install();
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& slot = GetSlot();
+		slot.mDone = false;
+		if (::pthread_kill(thread, GetSignal()) != 0)
+			return std::string();
+		for (auto wait = 0; wait < 1000 && !slot.mDone; ++wait)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return slot.mDone ? Format(slot.mFrames, slot.mCount) : std::string();
+	}
+
+	//Makes the signal handler of this process write the frames to descriptor (-1 to stop).
+	static void SetFrameDescriptor(int descriptor)
+	{
+		Install();
+		GetSlot().mDescriptor = descriptor;
+	}
+#else
+	typedef int ThreadHandle;
+
+	static ThreadHandle GetCurrentThread()
+	{
+		return 0;
+	}
+
+	static int GetSignal()
+	{
+		return 0;
+	}
+
+	static std::string Capture(ThreadHandle thread)
+	{
+		return std::string();
+	}
+
+	static void SetFrameDescriptor(int descriptor)
+	{
+	}
+#endif
+
+	static std::string Format(void* const* frames, int count)
+	{
+		std::ostringstream out;
+#if defined(__GLIBC__) || defined(__APPLE__)
+		auto symbols = ::backtrace_symbols(frames, count);
+		for (auto index = 0; index < count; ++index)
+		{
+			out << "  #" << index << " ";
+			if (symbols != nullptr)
+				out << symbols[index];
+			else
+				out << frames[index];
+			out << std::endl;
+		}
+		std::free(symbols);
+#endif
+		return out.str();
+	}
+
+private:
+#if defined(__GLIBC__) || defined(__APPLE__)
+	class Slot
+	{
+	public:
+		Slot()
+			: mCount(0), mDescriptor(-1), mDone(false)
+		{
+		}
+
+		void* mFrames[MaxFrames];
+		int mCount;
+		int mDescriptor;
+		std::atomic<bool> mDone;
+	};
+
+	static Slot& GetSlot()
+	{
+		static Slot slot;
+		return slot;
+	}
+
+	static void OnSignal(int)
+	{
+		//The first frames are this handler and the signal trampoline.
+		static const int HandlerFrames = 2;
+		auto savedErrno = errno;
+		void* frames[MaxFrames + HandlerFrames];
+		auto& slot = GetSlot();
+		auto count = ::backtrace(frames, MaxFrames + HandlerFrames);
+		slot.mCount = count > HandlerFrames ? count - HandlerFrames : 0;
+		std::memcpy(slot.mFrames, frames + HandlerFrames, slot.mCount * sizeof(void*));
+		if (slot.mDescriptor >= 0)
+		{
+			char frame[sizeof(unsigned int) * 2 + sizeof(slot.mFrames)];
+			unsigned int marker = FrameMarker;
+			unsigned int count = slot.mCount;
+			std::memcpy(frame, &marker, sizeof(marker));
+			std::memcpy(frame + sizeof(marker), &count, sizeof(count));
+			std::memcpy(frame + sizeof(marker) + sizeof(count), slot.mFrames, count * sizeof(void*));
+			auto size = sizeof(marker) + sizeof(count) + count * sizeof(void*);
+			if (::write(slot.mDescriptor, frame, size) < 0)
+				slot.mCount = 0;
+		}
+		slot.mDone = true;
+		errno = savedErrno;
+	}
+#endif
+};
+
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace UnitTest
+{
+
+// TestThreadPool is a work-stealing thread pool.  Each worker owns a deque of tasks;
+// tasks pushed from a worker go to the back of that worker's deque and are popped
+// LIFO by the owner (keeping a test class's methods on a warm thread), while idle
+// workers steal the oldest task from the front of another worker's deque.
+//
+// A worker whose task hangs can be abandoned: its task is counted as finished, the
+// thread is detached and a replacement thread takes over its deque.  If the hung
+// task ever returns, the abandoned thread exits without touching the pool again.
+//
+// Example:
+//	TestThreadPool pool(4);
+//	pool.Push([&]() { pool.Push(...); });
+//	pool.Wait();
+class TestThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	TestThreadPool(unsigned long threadCount)
+		: mStopping(false), mQueuedCount(0), mPendingCount(0), mNextQueue(0)
+	{
+		if (threadCount == 0)
+			threadCount = 1;
+		for (auto index = 0ul; index < threadCount; ++index)
+			mQueues.push_back(std::unique_ptr<Queue>(new Queue()));
+		for (auto index = 0ul; index < threadCount; ++index)
+			mThreads.push_back(StartWorker(index));
+	}
+
+	~TestThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mWorkAvailable.notify_all();
+		for (auto& thread : mThreads)
+			thread.mThread.join();
+	}
+
+	TestThreadPool(const TestThreadPool& rhs) = delete;
+	TestThreadPool& operator=(const TestThreadPool& rhs) = delete;
+
+	unsigned long GetThreadCount() const
+	{
+		return mThreads.size();
+	}
+
+	//Returns the index of the calling worker thread or GetThreadCount() if the caller is not a worker.
+	unsigned long GetCurrentWorker() const
+	{
+		auto& current = GetCurrent();
+		return current.mPool == this ? current.mIndex : GetThreadCount();
+	}
+
+	void Push(Task task)
+	{
+		auto worker = GetCurrentWorker();
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			++mQueuedCount;
+			++mPendingCount;
+			if (worker == GetThreadCount())
+				worker = mNextQueue++ % GetThreadCount();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mQueues[worker]->mMutex);
+			mQueues[worker]->mTasks.push_back(std::move(task));
+		}
+		mWorkAvailable.notify_one();
+	}
+
+	//Counts the task running on worker as finished and replaces the worker's thread.
+	//Must not be called from the worker itself.
+	void Abandon(unsigned long worker)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto& thread = mThreads[worker];
+		*thread.mAbandoned = true;
+		thread.mThread.detach();
+		thread = StartWorker(worker);
+		if (--mPendingCount == 0)
+			mIdle.notify_all();
+	}
+
+	//Blocks until every pushed task (including tasks pushed by other tasks) has finished.
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mIdle.wait(lock, [this]() { return mPendingCount == 0; });
+	}
+
+private:
+	class Queue
+	{
+	public:
+		std::mutex mMutex;
+		std::deque<Task> mTasks;
+	};
+
+	class Thread
+	{
+	public:
+		std::thread mThread;
+		std::shared_ptr<std::atomic<bool>> mAbandoned;
+	};
+
+	class Current
+	{
+	public:
+		Current()
+			: mPool(nullptr), mIndex(0)
+		{
+		}
+
+		const TestThreadPool* mPool;
+		unsigned long mIndex;
+	};
+
+	static Current& GetCurrent()
+	{
+		static thread_local Current current;
+		return current;
+	}
+
+	Thread StartWorker(unsigned long index)
+	{
+		Thread thread;
+		thread.mAbandoned = std::make_shared<std::atomic<bool>>(false);
+		thread.mThread = std::thread(&TestThreadPool::WorkerMain, this, index, thread.mAbandoned);
+		return thread;
+	}
+
+	bool TryPopOwn(unsigned long index, Task& task)
+	{
+		auto& queue = *mQueues[index];
+		std::lock_guard<std::mutex> lock(queue.mMutex);
+		if (queue.mTasks.empty())
+			return false;
+		task = std::move(queue.mTasks.back());
+		queue.mTasks.pop_back();
+		return true;
+	}
+
+	bool TrySteal(unsigned long index, Task& task)
+	{
+		for (auto offset = 1ul; offset < mQueues.size(); ++offset)
+		{
+			auto& queue = *mQueues[(index + offset) % mQueues.size()];
+			std::lock_guard<std::mutex> lock(queue.mMutex);
+			if (!queue.mTasks.empty())
+			{
+				task = std::move(queue.mTasks.front());
+				queue.mTasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerMain(unsigned long index, std::shared_ptr<std::atomic<bool>> abandoned)
+	{
+		GetCurrent().mPool = this;
+		GetCurrent().mIndex = index;
+		for (;;)
+		{
+			Task task;
+			if (TryPopOwn(index, task) || TrySteal(index, task))
+			{
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					--mQueuedCount;
+				}
+				task();
+				if (*abandoned)
+					return;
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (--mPendingCount == 0)
+					mIdle.notify_all();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWorkAvailable.wait(lock, [this]() { return mStopping || mQueuedCount > 0; });
+			if (mStopping && mQueuedCount == 0)
+				return;
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	std::vector<Thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mWorkAvailable;
+	std::condition_variable mIdle;
+	bool mStopping;
+	unsigned long mQueuedCount;
+	unsigned long mPendingCount;
+	unsigned long mNextQueue;
+};
+
+}
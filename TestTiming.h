@@ -0,0 +1,233 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include "TestAllocations.h"
+#include "TestHardwareCounters.h"
+#if defined(__linux__)
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+namespace UnitTest
+{
+
+// TestPhaseTiming holds the resources used by one phase of a unit test: wall clock
+// time, CPU time of the executing thread and the number of context switches of the
+// executing thread.  CPU time and context switches are only measured on Linux (CPU
+// time is also measured on Windows when <windows.h> is included first) and are zero
+// elsewhere.
+class TestPhaseTiming
+{
+public:
+	TestPhaseTiming()
+		: mWallNanoseconds(0),
+		mCpuNanoseconds(0),
+		mVoluntaryContextSwitches(0),
+		mInvoluntaryContextSwitches(0)
+	{
+	}
+
+	TestPhaseTiming& operator+=(const TestPhaseTiming& rhs)
+	{
+		mWallNanoseconds += rhs.mWallNanoseconds;
+		mCpuNanoseconds += rhs.mCpuNanoseconds;
+		mVoluntaryContextSwitches += rhs.mVoluntaryContextSwitches;
+		mInvoluntaryContextSwitches += rhs.mInvoluntaryContextSwitches;
+		return *this;
+	}
+
+	unsigned long long mWallNanoseconds;
+	unsigned long long mCpuNanoseconds;
+	unsigned long long mVoluntaryContextSwitches;
+	unsigned long long mInvoluntaryContextSwitches;
+};
+
+// TestRepeatStatistics summarizes a unit test that was run mRuns times (on mThreadCount
+// threads at once): how many runs passed and the distribution of the run durations.
+// mRuns is 0 for a unit test that ran once.
+class TestRepeatStatistics
+{
+public:
+	TestRepeatStatistics()
+		: mRuns(0),
+		mPassedRuns(0),
+		mThreadCount(0),
+		mMinNanoseconds(0),
+		mMedianNanoseconds(0),
+		mP99Nanoseconds(0),
+		mMaxNanoseconds(0)
+	{
+	}
+
+	double GetPassRate() const
+	{
+		return mRuns == 0 ? 1.0 : static_cast<double>(mPassedRuns) / mRuns;
+	}
+
+	unsigned long mRuns;
+	unsigned long mPassedRuns;
+	unsigned long mThreadCount;
+	unsigned long long mMinNanoseconds;
+	unsigned long long mMedianNanoseconds;
+	unsigned long long mP99Nanoseconds;
+	unsigned long long mMaxNanoseconds;
+};
+
+// TestBenchmarkStatistics summarizes a BENCHMARK_METHOD: mSamples timed samples of
+// mIterations loop iterations each, the sample durations per iteration (sorted) and their
+// mean, median and standard deviation.  When compared with a baseline (see
+// TestBenchmarkRecorder) mChange is the relative change of the median versus the baseline
+// median and mConfidence the confidence that the change is real.  mSamples is 0 for a
+// unit test.
+class TestBenchmarkStatistics
+{
+public:
+	TestBenchmarkStatistics()
+		: mSamples(0),
+		mIterations(0),
+		mMeanNanoseconds(0),
+		mMedianNanoseconds(0),
+		mStandardDeviationNanoseconds(0),
+		mCompared(false),
+		mBaselineMedianNanoseconds(0),
+		mChange(0),
+		mConfidence(0)
+	{
+	}
+
+	unsigned long mSamples;
+	unsigned long long mIterations;
+	std::vector<double> mSampleNanoseconds;
+	double mMeanNanoseconds;
+	double mMedianNanoseconds;
+	double mStandardDeviationNanoseconds;
+	bool mCompared;
+	double mBaselineMedianNanoseconds;
+	double mChange;
+	double mConfidence;
+};
+
+// TestTiming is the per phase timing of a unit test.  For a test method mBeginTest
+// covers constructing the test class instance and BeginTest, mMethod covers the
+// test method body and mEndTest covers EndTest.  For InitializeTests and
+// TerminateTests only mMethod is used.  mAllocations is only counted for test
+// methods when allocation tracking is enabled (see TestAllocations) and mCounters
+// when hardware counters are enabled (see TestHardwareCounters).  A repeated
+// unit test reports the phases and allocations of its median run plus mRepeat.  A
+// benchmark reports the phases of all its runs (calibration, warmup and samples)
+// plus mBenchmark.
+class TestTiming
+{
+public:
+	TestPhaseTiming GetTotal() const
+	{
+		TestPhaseTiming total;
+		total += mBeginTest;
+		total += mMethod;
+		total += mEndTest;
+		return total;
+	}
+
+	TestPhaseTiming mBeginTest;
+	TestPhaseTiming mMethod;
+	TestPhaseTiming mEndTest;
+	TestAllocationCounts mAllocations;
+	TestHardwareCounts mCounters;
+	TestRepeatStatistics mRepeat;
+	TestBenchmarkStatistics mBenchmark;
+};
+
+// TestPhaseTimer measures consecutive phases on the calling thread.  Starting a phase
+// stops the previous one, so a sequence of Start calls followed by Stop attributes
+// every measured interval to exactly one phase.
+//
+// Example:
+//	TestPhaseTimer timer;
+//	timer.Start(timing.mBeginTest);
+//	instance->BeginTest();
+//	timer.Start(timing.mMethod);
+//	method->Execute();
+//	timer.Stop();
+class TestPhaseTimer
+{
+public:
+	TestPhaseTimer()
+		: mPhase(nullptr)
+	{
+	}
+
+	void Start(TestPhaseTiming& phase)
+	{
+		auto sample = Sample::Now();
+		Record(sample);
+		mPhase = &phase;
+		mStart = sample;
+	}
+
+	void Stop()
+	{
+		Record(Sample::Now());
+		mPhase = nullptr;
+	}
+
+private:
+	class Sample
+	{
+	public:
+		Sample()
+			: mCpuNanoseconds(0), mVoluntaryContextSwitches(0), mInvoluntaryContextSwitches(0)
+		{
+		}
+
+		static Sample Now()
+		{
+			Sample sample;
+			sample.mWall = std::chrono::steady_clock::now();
+#if defined(__linux__)
+			timespec cpu;
+			if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0)
+				sample.mCpuNanoseconds = cpu.tv_sec * 1000000000ull + cpu.tv_nsec;
+			rusage usage;
+			if (::getrusage(RUSAGE_THREAD, &usage) == 0)
+			{
+				sample.mVoluntaryContextSwitches = usage.ru_nvcsw;
+				sample.mInvoluntaryContextSwitches = usage.ru_nivcsw;
+			}
+#elif defined(_WINDOWS_)
+			FILETIME creation, exit, kernel, user;
+			if (::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user))
+				sample.mCpuNanoseconds = (ToTicks(kernel) + ToTicks(user)) * 100;
+#endif
+			return sample;
+		}
+
+#if defined(_WINDOWS_) && !defined(__linux__)
+		static unsigned long long ToTicks(const FILETIME& time)
+		{
+			return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		}
+#endif
+
+		std::chrono::steady_clock::time_point mWall;
+		unsigned long long mCpuNanoseconds;
+		unsigned long long mVoluntaryContextSwitches;
+		unsigned long long mInvoluntaryContextSwitches;
+	};
+
+	void Record(const Sample& sample)
+	{
+		if (mPhase == nullptr)
+			return;
+		mPhase->mWallNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(sample.mWall - mStart.mWall).count();
+		mPhase->mCpuNanoseconds += sample.mCpuNanoseconds - mStart.mCpuNanoseconds;
+		mPhase->mVoluntaryContextSwitches += sample.mVoluntaryContextSwitches - mStart.mVoluntaryContextSwitches;
+		mPhase->mInvoluntaryContextSwitches += sample.mInvoluntaryContextSwitches - mStart.mInvoluntaryContextSwitches;
+	}
+
+private:
+	TestPhaseTiming* mPhase;
+	Sample mStart;
+};
+
+}
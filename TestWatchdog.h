@@ -0,0 +1,108 @@
+#pragma once
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace UnitTest
+{
+
+// TestWatchdog calls a callback on its own thread when a watch is not cancelled
+// before its deadline.  The callback is called without any lock held, so a watch
+// can expire while (or just after) it is being cancelled; callers must decide
+// which side wins (e.g. with an atomic flag).
+//
+// Example:
+//	TestWatchdog watchdog;
+//	auto watch = watchdog.Watch(1000, []() { ... });
+//	RunTest();
+//	watchdog.Cancel(watch);
+class TestWatchdog
+{
+public:
+	typedef std::function<void()> Expired;
+
+	TestWatchdog()
+		: mStopping(false), mNextWatch(0)
+	{
+		mThread = std::thread(&TestWatchdog::Main, this);
+	}
+
+	~TestWatchdog()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mChanged.notify_all();
+		mThread.join();
+	}
+
+	TestWatchdog(const TestWatchdog& rhs) = delete;
+	TestWatchdog& operator=(const TestWatchdog& rhs) = delete;
+
+	unsigned long Watch(unsigned long milliseconds, Expired expired)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto watch = ++mNextWatch;
+		Entry entry;
+		entry.mDeadline = Clock::now() + std::chrono::milliseconds(milliseconds);
+		entry.mExpired = std::move(expired);
+		mWatches.insert(std::make_pair(watch, std::move(entry)));
+		mChanged.notify_all();
+		return watch;
+	}
+
+	void Cancel(unsigned long watch)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mWatches.erase(watch);
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	class Entry
+	{
+	public:
+		Clock::time_point mDeadline;
+		Expired mExpired;
+	};
+
+	void Main()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (!mStopping)
+		{
+			auto next = mWatches.end();
+			for (auto iter = mWatches.begin(); iter != mWatches.end(); ++iter)
+				if (next == mWatches.end() || iter->second.mDeadline < next->second.mDeadline)
+					next = iter;
+
+			if (next == mWatches.end())
+				mChanged.wait(lock);
+			else if (next->second.mDeadline > Clock::now())
+				mChanged.wait_until(lock, next->second.mDeadline);
+			else
+			{
+				auto expired = std::move(next->second.mExpired);
+				mWatches.erase(next);
+				lock.unlock();
+				expired();
+				lock.lock();
+			}
+		}
+	}
+
+private:
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mChanged;
+	bool mStopping;
+	unsigned long mNextWatch;
+	std::map<unsigned long, Entry> mWatches;
+};
+
+}
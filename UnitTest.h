@@ -1,6 +1,7 @@
 #pragma once
 #include "TestClass.h"
 #include "TestMethod.h"
+#include "TestRowMethod.h"
 #include "TestRunner.h"
 #include "TestRunWriter.h"
 #include "TestAssert.h"